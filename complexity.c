@@ -0,0 +1,548 @@
+#include "cps-re.h"
+#include "parse.h"
+#include <stdlib.h>
+
+// a worst-case complexity classifier for the backtracker. a regex is compiled
+// to an nfa much like the pike vm's, in which every path is a way for the
+// backtracker to match, so the time the backtracker takes is bounded by the
+// number of paths the nfa has for prefixes of the input. that number is
+// exponential if and only if some state loops back to itself over the same
+// input along two different paths, which is found on the product of the nfa
+// with itself. otherwise it's polynomial, of a degree bounded by the longest
+// chain of loops that can all consume the same characters one after the
+// other, as in `a*a*`. `!` is a loop that runs the term it complements once
+// per position of the input, and `a&b` runs `b` once per match of `a`, so both
+// add the degree of their operand to that of the paths leading to them.
+// parallel paths matter: `(a*)*` has a single `CLASS` node, but two paths from
+// it back to itself, one through each `*`. iterations that consume nothing are
+// cut short by the backtracker, so paths in between two `CLASS` nodes take
+// every loop back at most once. possessive quantifiers count as greedy ones.
+// regexes may be untrusted, so the analysis as a whole gets a budget of steps,
+// and gives up and says exponential when it runs out
+
+#define EXP INT_MAX       // degree of exponential time
+#define BUDGET (1L << 24) // steps of analysis before giving up
+
+struct node {
+  enum { CLASS, SPLIT, JMP, END } op;
+  unsigned char chars[32]; // for `CLASS`, as a bitset
+  int x, y;    // for `SPLIT` and `JMP`. `CLASS` continues with the next node
+  bool back;   // whether `x` loops back
+  int extra;   // degree of the work done whenever this node is reached
+  char *blame; // the subexpression responsible for `extra`
+};
+
+struct loop {
+  char *factor;
+  int len;    // of `factor`
+  int lo, hi; // its nodes
+};
+
+struct nfa {
+  int len, nloops;
+  struct node *nodes;
+  struct loop *loops;
+  long *budget; // shared with the nfas of operands of `!` and `&`
+  int *begin, *end, *succ, *mult; // `CLASS` nodes that follow each, see `edges`
+  int nedges, cap;
+  int *comp;          // the strongly connected component of each node
+  int *order, *first; // nodes by component, component `c` from `first[c]` on
+  bool *used;         // see `reached`
+  int *count, *stack, *touched, ntouched;
+};
+
+static int add(int a, int b) { return a == EXP || b == EXP ? EXP : a + b; }
+
+static bool overlap(unsigned char *a, unsigned char *b) {
+  for (int i = 0; i < 32; i++)
+    if (a[i] & b[i])
+      return true;
+  return false;
+}
+
+static int analyze(char *regex, bool term, long *budget, char **blame);
+
+static int emit(struct nfa *nfa, struct node node) {
+  nfa->nodes[nfa->len] = node;
+  return nfa->len++;
+}
+
+static void add_loop(struct nfa *nfa, char *factor, int len, int lo) {
+  nfa->loops[nfa->nloops++] =
+      (struct loop){.factor = factor, .len = len, .lo = lo, .hi = nfa->len};
+}
+
+static void compile_any(struct nfa *nfa, char *factor, int len,
+                        struct node split) {
+  // `.*`, for `%` and `!`
+  int begin = emit(nfa, split);
+  struct node any = {.op = CLASS};
+  memset(any.chars, 0xff, sizeof(any.chars)), any.chars[0] &= ~1;
+  nfa->nodes[begin].x = emit(nfa, any);
+  emit(nfa, (struct node){.op = JMP, .x = begin, .back = true});
+  nfa->nodes[begin].y = nfa->len;
+  add_loop(nfa, factor, len, begin);
+}
+
+static void compile_regex(struct nfa *nfa, char *regex);
+static void compile_atom(struct nfa *nfa, char *atom) {
+  if (*atom == '%')
+    compile_any(nfa, atom, 1, (struct node){.op = SPLIT});
+  else if (*atom == '(')
+    compile_regex(nfa, atom + 1);
+  else {
+    struct node node = {.op = CLASS};
+    char lower, upper;
+    bool compl;
+    parse_class(atom, &lower, &upper, &compl);
+    for (int chr = CHAR_MIN; chr <= CHAR_MAX; chr++)
+      if (chr && (lower <= chr && chr <= upper) ^ compl)
+        node.chars[(unsigned char)chr / 8] |= 1 << (unsigned char)chr % 8;
+    emit(nfa, node);
+  }
+}
+
+static void compile_factor(struct nfa *nfa, char *factor) {
+  char *quant = parse_atom(factor);
+  int begin = nfa->len, split;
+
+  switch (*quant) {
+  case '*':
+    split = emit(nfa, (struct node){.op = SPLIT});
+    compile_atom(nfa, factor);
+    emit(nfa, (struct node){.op = JMP, .x = split, .back = true});
+    nfa->nodes[split].x = split + 1, nfa->nodes[split].y = nfa->len;
+    break;
+  case '+':
+    compile_atom(nfa, factor);
+    split = emit(nfa, (struct node){.op = SPLIT, .x = begin, .back = true});
+    nfa->nodes[split].y = nfa->len;
+    break;
+  case '?':
+    split = emit(nfa, (struct node){.op = SPLIT});
+    compile_atom(nfa, factor);
+    nfa->nodes[split].x = split + 1, nfa->nodes[split].y = nfa->len;
+    return;
+  default:
+    compile_atom(nfa, factor);
+    return;
+  }
+  add_loop(nfa, factor, parse_factor(factor) - factor, begin);
+}
+
+static void compile_term(struct nfa *nfa, char *term) {
+  if (*term == '!') {
+    // the complemented term runs once for every position of the input, every
+    // time the loop is entered
+    char *blame = term, *inner = NULL;
+    int extra = add(1, analyze(term + 1, true, nfa->budget, &inner));
+    blame = extra == EXP ? inner : blame;
+    emit(nfa, (struct node){.op = JMP, .x = nfa->len + 1, .extra = extra,
+                            .blame = blame});
+    compile_any(nfa, term, parse_term(term) - term,
+                (struct node){.op = SPLIT});
+    return;
+  }
+  for (char *next; (next = parse_factor(term)) != NULL; term = next)
+    compile_factor(nfa, term);
+}
+
+static void compile_regex(struct nfa *nfa, char *regex) {
+  // alternation and intersection are right-associative. alternatives are
+  // compiled in a loop rather than recursively, as there can be many. the
+  // `JMP`s past them are chained through `x` until we know where they go
+  int jmps = -1;
+  while (1) {
+    char *binop = parse_term(regex);
+    if (*binop == '&') {
+      // the right-hand side runs once for every match of the left-hand side
+      char *blame = regex, *inner = NULL;
+      compile_term(nfa, regex);
+      int extra = analyze(binop + 1, false, nfa->budget, &inner);
+      blame = extra == EXP ? inner : blame;
+      emit(nfa, (struct node){.op = JMP, .x = nfa->len + 1, .extra = extra,
+                              .blame = blame});
+      break;
+    }
+    if (*binop != '|') {
+      compile_term(nfa, regex);
+      break;
+    }
+
+    int split = emit(nfa, (struct node){.op = SPLIT});
+    compile_term(nfa, regex);
+    jmps = emit(nfa, (struct node){.op = JMP, .x = jmps});
+    nfa->nodes[split].x = split + 1, nfa->nodes[split].y = nfa->len;
+    regex = binop + 1;
+  }
+
+  for (int jmp = jmps, next; jmp >= 0; jmp = next)
+    next = nfa->nodes[jmp].x, nfa->nodes[jmp].x = nfa->len;
+}
+
+static void reached(struct nfa *nfa, int from) {
+  // count the paths that consume no input from right after `CLASS` node
+  // `from`, or from the start if `from` is negative, to every node, up to 2.
+  // `used` holds the loops taken back so far. once a node is reached twice, so
+  // is everything after it, so we stop there. the nodes reached are `touched`,
+  // so only those need clearing next time. the stack holds nodes to visit, and
+  // `~at` to allow taking loop `at` back again, so it's 2 pushes per visit of
+  // `SPLIT` nodes and 3 for loops, and nodes are visited at most twice
+  while (nfa->ntouched)
+    nfa->count[nfa->touched[--nfa->ntouched]] = 0;
+  int sp = 0;
+  nfa->stack[sp++] = from + 1;
+  while (sp) {
+    int at = nfa->stack[--sp];
+    --*nfa->budget;
+    if (at < 0) {
+      nfa->used[~at] = false;
+      continue;
+    }
+    struct node *node = &nfa->nodes[at];
+    if (nfa->count[at] == 2)
+      continue;
+    if (nfa->count[at]++ == 0)
+      nfa->touched[nfa->ntouched++] = at;
+    if (node->op == CLASS || node->op == END)
+      continue;
+    if (node->op == SPLIT)
+      nfa->stack[sp++] = node->y;
+    if (!node->back)
+      nfa->stack[sp++] = node->x;
+    else if (!nfa->used[at])
+      nfa->used[at] = true, nfa->stack[sp++] = ~at, nfa->stack[sp++] = node->x;
+  }
+}
+
+static bool edges(struct nfa *nfa) {
+  // the `CLASS` nodes that can follow `CLASS` node `p` are `succ[begin[p]]` to
+  // `succ[end[p] - 1]`, with `mult` paths to each
+  for (int p = 0; p < nfa->len; p++) {
+    nfa->begin[p] = nfa->end[p] = nfa->nedges;
+    if (*nfa->budget < 0)
+      return false;
+    if (nfa->nodes[p].op != CLASS)
+      continue;
+    reached(nfa, p);
+    for (int i = 0; i < nfa->ntouched; i++) {
+      int at = nfa->touched[i];
+      if (nfa->nodes[at].op != CLASS)
+        continue;
+      if (nfa->nedges == nfa->cap) {
+        int cap = nfa->cap * 2 + 16, *succ, *mult;
+        if ((succ = realloc(nfa->succ, cap * sizeof(*succ))) != NULL)
+          nfa->succ = succ;
+        if ((mult = realloc(nfa->mult, cap * sizeof(*mult))) != NULL)
+          nfa->mult = mult;
+        if (succ == NULL || mult == NULL)
+          return false;
+        nfa->cap = cap;
+      }
+      nfa->succ[nfa->nedges] = at, nfa->mult[nfa->nedges++] = nfa->count[at];
+    }
+    nfa->end[p] = nfa->nedges;
+  }
+  return true;
+}
+
+static int *components(int len, int stride,
+                       int (*next)(void *, int, int *), void *ctx) {
+  // tarjan's algorithm, without recursion as graphs can be large. returns the
+  // strongly connected component of every vertex reachable from a multiple of
+  // `stride`, numbered such that edges only go from a component to itself or
+  // to a lower-numbered one, and -1 for other vertices. `next(ctx, v, &iter)`
+  // returns the next successor of `v`, or -1
+  int *index = malloc(len * sizeof(int)), *low = malloc(len * sizeof(int));
+  int *comp = malloc(len * sizeof(int)), *stack = malloc(len * sizeof(int));
+  int *calls = malloc(len * sizeof(int)), *iters = malloc(len * sizeof(int));
+  if (index == NULL || low == NULL || comp == NULL || stack == NULL ||
+      calls == NULL || iters == NULL) {
+    free(comp), comp = NULL;
+    goto done;
+  }
+
+  int count = 0, sp = 0, ncomps = 0;
+  for (int v = 0; v < len; v++)
+    index[v] = comp[v] = -1;
+  for (int root = 0; root < len; root += stride) {
+    if (index[root] >= 0)
+      continue;
+    int ncalls = 0;
+    calls[ncalls++] = root, index[root] = low[root] = count++;
+    stack[sp++] = root, iters[root] = 0;
+    while (ncalls) {
+      int v = calls[ncalls - 1], w = next(ctx, v, &iters[v]);
+      if (w >= 0 && index[w] < 0) {
+        calls[ncalls++] = w, index[w] = low[w] = count++;
+        stack[sp++] = w, iters[w] = 0;
+      } else if (w >= 0 && comp[w] < 0 && index[w] < low[v])
+        low[v] = index[w]; // `w` is on the stack
+      else if (w < 0) {
+        if (--ncalls && low[v] < low[calls[ncalls - 1]])
+          low[calls[ncalls - 1]] = low[v];
+        if (low[v] == index[v]) {
+          do
+            comp[stack[--sp]] = ncomps;
+          while (stack[sp] != v);
+          ncomps++;
+        }
+      }
+    }
+  }
+
+done:
+  free(index), free(low), free(stack), free(calls), free(iters);
+  return comp;
+}
+
+static int next_edge(void *ctx, int v, int *iter) {
+  struct nfa *nfa = ctx;
+  int edge = nfa->begin[v] + *iter;
+  return edge < nfa->end[v] ? (++*iter, nfa->succ[edge]) : -1;
+}
+
+struct pairs {
+  // the product of the subgraph of a component with itself. vertex `i * size +
+  // j` is the pair of `members[i]` and `members[j]`
+  struct nfa *nfa;
+  int *members, size, comp;
+  int *member; // index in `members` of every node
+};
+
+static int next_pair(void *ctx, int v, int *iter) {
+  struct pairs *pairs = ctx;
+  struct nfa *nfa = pairs->nfa;
+  int p = pairs->members[v / pairs->size], q = pairs->members[v % pairs->size];
+  int np = nfa->end[p] - nfa->begin[p], nq = nfa->end[q] - nfa->begin[q];
+  while (*iter < np * nq && (*nfa->budget)-- > 0) {
+    int a = nfa->begin[p] + *iter / nq, b = nfa->begin[q] + *iter % nq;
+    int p2 = nfa->succ[a], q2 = nfa->succ[b];
+    ++*iter;
+    if (nfa->comp[p2] == pairs->comp && nfa->comp[q2] == pairs->comp &&
+        overlap(nfa->nodes[p2].chars, nfa->nodes[q2].chars))
+      return pairs->member[p2] * pairs->size + pairs->member[q2];
+  }
+  return -1;
+}
+
+static int ambiguous(struct nfa *nfa, int comp, int *members, int size,
+                     int *member) {
+  // whether two different paths of the component lead from one of its nodes
+  // back to it over the same input, that is, whether in the product some
+  // `(x, x)` reaches itself through a pair of different edges. only pairs
+  // reachable from some `(x, x)` matter. returns -1 if the product is too
+  // large to look at, or if we run out of memory or budget
+  struct pairs pairs = {nfa, members, size, comp, member};
+  int *pcomp = NULL;
+  if (size <= 1024)
+    pcomp = components(size * size, size + 1, next_pair, &pairs);
+  if (pcomp == NULL || *nfa->budget < 0)
+    return free(pcomp), -1;
+
+  bool found = false;
+  for (int i = 0; i < size && !found; i++) {
+    int x = members[i], diag = i * size + i;
+    for (int a = nfa->begin[x]; a < nfa->end[x] && !found; a++)
+      for (int b = nfa->begin[x]; b < nfa->end[x] && !found; b++) {
+        if ((*nfa->budget)-- < 0)
+          return free(pcomp), -1;
+        int p = nfa->succ[a], q = nfa->succ[b];
+        if (nfa->comp[p] != comp || nfa->comp[q] != comp ||
+            !overlap(nfa->nodes[p].chars, nfa->nodes[q].chars) ||
+            (a == b && nfa->mult[a] < 2))
+          continue;
+        found = pcomp[member[p] * size + member[q]] == pcomp[diag];
+      }
+  }
+  free(pcomp);
+  return found;
+}
+
+static bool chains(struct nfa *nfa, int from, int to, unsigned char *chars,
+                   int *seen, int stamp, int *queue) {
+  // whether some node of component `from` reaches one of component `to`
+  // through nodes that all match some of `chars`. nodes with `seen[p] ==
+  // stamp` have been seen, which saves clearing `seen` on every call
+  int head = 0, tail = 0;
+  for (int i = nfa->first[from]; i < nfa->first[from + 1]; i++)
+    seen[nfa->order[i]] = stamp, queue[tail++] = nfa->order[i];
+  while (head < tail) {
+    int p = queue[head++];
+    for (int e = nfa->begin[p]; e < nfa->end[p]; e++) {
+      int q = nfa->succ[e];
+      if (--*nfa->budget < 0)
+        return false;
+      if (seen[q] == stamp || !overlap(nfa->nodes[q].chars, chars))
+        continue;
+      if (nfa->comp[q] == to)
+        return true;
+      seen[q] = stamp, queue[tail++] = q;
+    }
+  }
+  return false;
+}
+
+static int degree(struct nfa *nfa, char **blame) {
+  // see the top of the file
+  int len = nfa->len, result = EXP;
+  *blame = NULL;
+  nfa->used = calloc(len, sizeof(bool)), nfa->count = calloc(len, sizeof(int));
+  nfa->stack = malloc((len * 6 + 1) * sizeof(int));
+  nfa->touched = malloc(len * sizeof(int)), nfa->ntouched = 0;
+  nfa->order = malloc(len * sizeof(int));
+  nfa->first = malloc((len + 1) * sizeof(int));
+  int *seen = malloc(len * sizeof(int)), *queue = malloc(len * sizeof(int));
+  int *member = malloc(len * sizeof(int)), *ncomp = malloc(len * sizeof(int));
+  int *chain = malloc(len * sizeof(int)), *paths = malloc(len * sizeof(int));
+  int *loop = malloc(len * sizeof(int)), *cycles = malloc(len * sizeof(int));
+  bool *cyclic = calloc(len, sizeof(bool));
+  char **why = malloc(len * sizeof(char *));
+  unsigned char(*chars)[32] = calloc(len, sizeof(*chars));
+  nfa->begin = malloc(len * sizeof(int)), nfa->end = malloc(len * sizeof(int));
+  if (nfa->used == NULL || nfa->count == NULL || nfa->stack == NULL ||
+      nfa->touched == NULL || nfa->order == NULL || nfa->first == NULL ||
+      seen == NULL || queue == NULL || member == NULL || ncomp == NULL ||
+      chain == NULL || paths == NULL || loop == NULL || cycles == NULL ||
+      cyclic == NULL || why == NULL || chars == NULL || nfa->begin == NULL ||
+      nfa->end == NULL || !edges(nfa) || *nfa->budget < 0 ||
+      (nfa->comp = components(len, 1, next_edge, nfa)) == NULL)
+    goto done;
+
+  // the nodes of every component, whether it has a loop, and the widest one
+  int ncomps = 0;
+  for (int p = 0; p < len; p++) {
+    int comp = nfa->comp[p];
+    ncomps = comp >= ncomps ? comp + 1 : ncomps;
+    for (int i = 0; i < 32; i++)
+      chars[comp][i] |= nfa->nodes[p].chars[i];
+  }
+  for (int comp = 0; comp < ncomps; comp++)
+    ncomp[comp] = 0, loop[comp] = -1, chain[comp] = paths[comp] = 0;
+  for (int p = 0; p < len; p++)
+    member[p] = ncomp[nfa->comp[p]]++, seen[p] = -1;
+  nfa->first[0] = 0;
+  for (int comp = 0; comp < ncomps; comp++)
+    nfa->first[comp + 1] = nfa->first[comp] + ncomp[comp];
+  for (int p = 0; p < len; p++)
+    nfa->order[nfa->first[nfa->comp[p]] + member[p]] = p;
+  for (int i = 0; i < nfa->nloops; i++) {
+    struct loop *l = &nfa->loops[i];
+    for (int p = l->lo; p < l->hi; p++)
+      if (nfa->nodes[p].op == CLASS) {
+        int comp = nfa->comp[p];
+        if (loop[comp] < 0 || l->len > nfa->loops[loop[comp]].len)
+          loop[comp] = i;
+        break;
+      }
+  }
+
+  // exponential if any component is ambiguous
+  for (int comp = 0; comp < ncomps; comp++) {
+    int *members = &nfa->order[nfa->first[comp]];
+    if (nfa->nodes[members[0]].op != CLASS)
+      continue;
+    // components too large to pair up count as ambiguous
+    int amb = ambiguous(nfa, comp, members, ncomp[comp], member);
+    if (amb != 0) {
+      *blame = amb > 0 && loop[comp] >= 0 ? nfa->loops[loop[comp]].factor
+                                          : NULL;
+      goto done;
+    }
+  }
+
+  // chains of loops, in topological order, that is, from the highest number
+  for (int p = 0; p < len; p++)
+    for (int e = nfa->begin[p]; e < nfa->end[p]; e++)
+      cyclic[nfa->comp[p]] |= nfa->comp[nfa->succ[e]] == nfa->comp[p];
+
+  int ncycles = 0, stamp = 0, longest = 0;
+  for (int comp = ncomps - 1; comp >= 0; comp--) {
+    if (!cyclic[comp])
+      continue;
+    chain[comp] = 1, why[comp] = nfa->loops[loop[comp]].factor;
+    for (int i = 0; i < ncycles; i++) {
+      int prev = cycles[i];
+      unsigned char both[32];
+      for (int j = 0; j < 32; j++)
+        both[j] = chars[prev][j] & chars[comp][j];
+      if (--*nfa->budget < 0)
+        goto done;
+      if (chain[prev] + 1 > chain[comp] && overlap(both, both) &&
+          chains(nfa, prev, comp, both, seen, stamp++, queue))
+        chain[comp] = chain[prev] + 1, why[comp] = why[prev];
+    }
+    if (chain[comp] > longest)
+      longest = chain[comp], *blame = why[comp];
+    cycles[ncycles++] = comp;
+  }
+
+  // the number of paths that reach every component is of the degree of the
+  // longest chain that reaches it
+  for (int comp = ncomps - 1; comp >= 0; comp--) {
+    if (chain[comp] > paths[comp])
+      paths[comp] = chain[comp];
+    for (int i = nfa->first[comp]; i < nfa->first[comp + 1]; i++)
+      for (int e = nfa->begin[nfa->order[i]]; e < nfa->end[nfa->order[i]]; e++)
+        if (paths[comp] > paths[nfa->comp[nfa->succ[e]]])
+          paths[nfa->comp[nfa->succ[e]]] = paths[comp];
+  }
+
+  // and so does the number of times nodes with `extra` work are reached
+  for (int from = -1; from < len; from++) {
+    if (from >= 0 && nfa->nodes[from].op != CLASS)
+      continue;
+    reached(nfa, from);
+    for (int i = 0; i < nfa->ntouched; i++) {
+      int at = nfa->touched[i];
+      int work =
+          add(from < 0 ? 0 : paths[nfa->comp[from]], nfa->nodes[at].extra);
+      if (nfa->nodes[at].extra && work > longest)
+        longest = work, *blame = nfa->nodes[at].blame;
+    }
+  }
+  result = longest;
+
+done:
+  // giving up is exponential, with no one to blame
+  if (*nfa->budget < 0)
+    result = EXP, *blame = NULL;
+  free(nfa->used), free(nfa->count), free(nfa->stack), free(nfa->touched);
+  free(nfa->order), free(nfa->first), free(seen), free(queue), free(member);
+  free(ncomp), free(chain), free(paths), free(loop), free(cycles);
+  free(cyclic), free(why), free(chars);
+  free(nfa->begin), free(nfa->end), free(nfa->succ), free(nfa->mult);
+  free(nfa->comp);
+  return result;
+}
+
+static int analyze(char *regex, bool term, long *budget, char **blame) {
+  // the degree of the time matching the regex or term `regex` takes, 0 if
+  // it's constant. running out of memory or budget counts as exponential
+  size_t size = strlen(regex) * 4 + 2;
+  *blame = NULL;
+  if ((*budget -= size) < 0)
+    return EXP;
+  struct nfa nfa = {.nodes = malloc(size * sizeof(struct node)),
+                    .loops = malloc(size * sizeof(struct loop)),
+                    .budget = budget};
+  int result = EXP;
+  if (nfa.nodes != NULL && nfa.loops != NULL) {
+    term ? compile_term(&nfa, regex) : compile_regex(&nfa, regex);
+    emit(&nfa, (struct node){.op = END});
+    result = *budget < 0 ? EXP : degree(&nfa, blame);
+  }
+  free(nfa.nodes), free(nfa.loops);
+  return result;
+}
+
+int cpsre_complexity(char *regex, char **culprit) {
+  char *blame = NULL;
+  long budget = BUDGET;
+  if (*cpsre_parse(regex) != '\0')
+    return *culprit = NULL, 0;
+  int result = analyze(regex, false, &budget, &blame);
+  if (result == EXP)
+    return *culprit = blame, CPSRE_EXPONENTIAL;
+  return *culprit = result > 1 ? blame : NULL, result > 1 ? result : 1;
+}
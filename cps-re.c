@@ -1,6 +1,7 @@
 #include "cps-re.h"
 #include <setjmp.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
 // this regex engine walks regular expressions in continuation-passing style and
@@ -45,9 +46,29 @@ struct jmplist {
 #define CATCHJMP else
 #define LONGJMP(JMPLIST) longjmp(JMPLIST->jmp_buf, 1)
 
-static char *match_end;           // to store match end when a match is found
-static struct jmplist *match_jmp; // to unwind the stack when a match is found
-static struct jmplist *poss_jmp;  // to backtrack possessive quantifiers
+// matcher state is thread-local so independent matches can run concurrently
+#if __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL _Thread_local
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+static THREAD_LOCAL char *match_end;           // to store match end
+static THREAD_LOCAL struct jmplist *match_jmp; // to unwind the stack on match
+static THREAD_LOCAL struct jmplist *poss_jmp;  // to backtrack possessives
+
+// a cache of what `match_regex` knows about the alternatives it has seen. an
+// alternative, or term, is identified by its address in the regex, and only
+// for the duration of one call to `cpsre_anchored` or `cpsre_unanchored`, after
+// which `gen` changes. `may` is the set of characters a match of the term could
+// begin with, as far as `known`, see `may_begin`
+#define NALTS 128
+static THREAD_LOCAL struct alt {
+  char *regex, *binop; // the term and the end of the term
+  unsigned long gen;
+  unsigned char known[32], may[32];
+} alts[NALTS];
+static THREAD_LOCAL unsigned long gen;
 
 static void found_match(char *target, char *input, struct cont *_cont) {
   // report a match by unwinding the stack to the closest `SETJMP(match_jmp)`.
@@ -123,6 +144,27 @@ static char *parse_atom(char *regex) {
   return regex;                               // syntax or ok
 }
 
+static bool match_char(char *regex, char chr) {
+  // whether the atom `regex`, which is neither `%` nor `(...)`, matches `chr`
+  bool compl = *regex == '~' && regex++;
+
+  if (*regex == '.')
+    return chr && !compl ;
+
+  char lower, upper, temp;
+  regex = parse_symbol(regex, &lower), upper = lower;
+  if (regex != NULL && *regex == '-')
+    regex = parse_symbol(++regex, &upper);
+  if (regex == NULL)
+    return false; // syntax
+
+  // character range wraparound
+  if (lower > upper)
+    temp = upper, upper = lower - 1, lower = temp + 1, compl = !compl ;
+
+  return chr && (lower <= chr && chr <= upper) ^ compl ;
+}
+
 static void match_regex(char *regex, char *input, struct cont *cont);
 static void match_atom(char *regex, char *input, struct cont *cont) {
   if (*regex == '%') {
@@ -138,25 +180,7 @@ static void match_atom(char *regex, char *input, struct cont *cont) {
     return; // backtrack or syntax
   }
 
-  bool compl = *regex == '~' && regex++;
-
-  if (*regex == '.' && *input && true ^ compl ) {
-    cont->fp(cont->regex, ++input, cont->up);
-    return; // backtrack
-  }
-
-  char lower, upper, temp;
-  regex = parse_symbol(regex, &lower), upper = lower;
-  if (regex != NULL && *regex == '-')
-    regex = parse_symbol(++regex, &upper);
-  if (regex == NULL)
-    return;
-
-  // character range wraparound
-  if (lower > upper)
-    temp = upper, upper = lower - 1, lower = temp + 1, compl = !compl ;
-
-  if (*input && (lower <= *input && *input <= upper) ^ compl )
+  if (match_char(regex, *input))
     cont->fp(cont->regex, ++input, cont->up);
   return; // backtrack or syntax
 }
@@ -254,22 +278,52 @@ static char *parse_regex(char *regex) {
   return regex;
 }
 
+static char *anchored(char *regex, char *input, char *target);
 static void int_rhs(char *regex, char *input, struct cont *cont) {
   // the left-hand side of the intersection matched (beginning at input position
   // `cont->regex` and ending at input position `input`), so check if we can get
   // the right-hand side to exact-match at those positions
-  if (cpsre_anchored(regex, cont->regex, input) != NULL)
+  if (anchored(regex, cont->regex, input) != NULL)
     cont = cont->up, cont->fp(cont->regex, input, cont->up);
   return; // backtrack
 }
 
-static void match_regex(char *regex, char *input, struct cont *cont) {
-  char *binop = parse_term(regex);
+static bool may_begin(char *regex, char chr) {
+  // whether the term `regex` could match a word beginning with `chr`, or the
+  // empty word. errs on the side of `true`. used to skip alternatives that
+  // can't possibly match without entering them
+  if (*regex == '!')
+    return true;
+
+  for (char *factor; (factor = parse_factor(regex)) != NULL; regex = factor) {
+    if (*regex == '%' || *regex == '(' || match_char(regex, chr))
+      return true;
+    char *quant = parse_atom(regex);
+    if (*quant != '*' && *quant != '?')
+      return false;
+  }
 
-  // alternation and intersection are right-associative
-  if (*binop == '|')
-    match_term(regex, input, cont), match_regex(++binop, input, cont);
-  else if (*binop == '&')
+  return true;
+}
+
+static void match_regex(char *regex, char *input, struct cont *cont) {
+  // alternatives are parsed once per top-level call; see `struct alt`
+  struct alt *alt = &alts[(uintptr_t)regex % NALTS];
+  if (alt->regex != regex || alt->gen != gen)
+    *alt = (struct alt){.regex = regex, .gen = gen, .binop = parse_term(regex)};
+  char *binop = alt->binop;
+
+  // alternation and intersection are right-associative. only alternatives that
+  // can begin with the next input character are tried, in order
+  if (*binop == '|') {
+    unsigned char chr = *input, bit = 1 << chr % 8;
+    if (~alt->known[chr / 8] & bit && may_begin(regex, chr))
+      alt->may[chr / 8] |= bit;
+    alt->known[chr / 8] |= bit;
+    if (alt->may[chr / 8] & bit)
+      match_term(regex, input, cont);
+    match_regex(++binop, input, cont);
+  } else if (*binop == '&')
     // if the left-hand side of the intersection matches, call `int_rhs` with a
     // dummy continuation that holds the `input` position before the match
     match_term(regex, input, CONT(int_rhs, ++binop, CONT(NULL, input, cont)));
@@ -281,7 +335,7 @@ static void match_regex(char *regex, char *input, struct cont *cont) {
 
 char *cpsre_parse(char *regex) { return parse_regex(regex); }
 
-char *cpsre_anchored(char *regex, char *input, char *target) {
+static char *anchored(char *regex, char *input, char *target) {
   SETJMP(match_jmp) {
     match_regex(regex, input, CONT(found_match, target, NULL));
     UNSETJMP(match_jmp) { return NULL; }
@@ -290,11 +344,27 @@ char *cpsre_anchored(char *regex, char *input, char *target) {
   return match_end;
 }
 
+char *cpsre_anchored(char *regex, char *input, char *target) {
+  gen++; // the regex may have changed since the last call
+  return anchored(regex, input, target);
+}
+
 char *cpsre_unanchored(char *regex, char *input, char *target) {
+  gen++; // the regex may have changed since the last call
   do {
-    if (cpsre_anchored(regex, input, target) != NULL)
+    if (anchored(regex, input, target) != NULL)
       return input;
   } while (*input++);
 
   return NULL;
 }
+
+char *cpsre_unanchored_until(char *regex, char *input, char *limit,
+                             char *target) {
+  gen++; // the regex may have changed since the last call
+  for (; input < limit; input++)
+    if (anchored(regex, input, target) != NULL)
+      return input;
+
+  return NULL;
+}
@@ -1,3 +1,6 @@
+#include <stdbool.h>
+#include <stddef.h>
+
 // returns a pointer one past the end of a well-formed regular expression
 // beginning at `regex`, which will always exist because the empty regular
 // expression is well formed. to check whether an entire string is a well-
@@ -20,3 +23,150 @@ char *cpsre_parse(char *regex);
 // where `end` is a pointer to `input`'s null terminator
 char *cpsre_anchored(char *regex, char *input, char *target);
 char *cpsre_unanchored(char *regex, char *input, char *target);
+
+// returns what `cpsre_unanchored` returns, but only tries the beginnings of a
+// match before `limit`, which is at most one past `input`'s null terminator
+char *cpsre_unanchored_until(char *regex, char *input, char *limit,
+                             char *target);
+
+// returns exactly what `cpsre_unanchored` returns, but partitions the candidate
+// beginnings of a match across `nthreads` threads. useful for searching very
+// large inputs. matches to the right of a match already found are abandoned
+char *cpsre_unanchored_parallel(char *regex, char *input, char *target,
+                                int nthreads);
+
+// a regular expression compiled to native code. `cpsre_jit` returns null only
+// if it runs out of memory. regexes and platforms the jit does not support are
+// handled by the interpreter instead, in which case `cpsre_jit_native` returns
+// false. `cpsre_jit_anchored` and `cpsre_jit_unanchored` behave exactly like
+// `cpsre_anchored` and `cpsre_unanchored`. `regex` must outlive the `struct
+// cpsre_jit`, which must be freed with `cpsre_jit_free`
+struct cpsre_jit *cpsre_jit(char *regex);
+bool cpsre_jit_native(struct cpsre_jit *jit);
+char *cpsre_jit_anchored(struct cpsre_jit *jit, char *input, char *target);
+char *cpsre_jit_unanchored(struct cpsre_jit *jit, char *input, char *target);
+void cpsre_jit_free(struct cpsre_jit *jit);
+
+// a regular expression compiled for a pike vm, which runs in time linear in
+// the length of the input. `cpsre_pike` returns null only if it runs out of
+// memory. ill-formed regexes match nothing. regexes with `!`, `&` or
+// possessive quantifiers, and regexes that repeat a subexpression that matches
+// the empty word, are handled by the backtracker instead, in which case
+// `cpsre_pike_linear` returns false.
+// regexes with at most 64 character classes and no `!` or `&` also get a
+// bit-parallel automaton, which answers searches with a `target`, searches that
+// find no match and, for regexes left to the backtracker, unanchored searches
+// without running the vm at all. programs loaded with `cpsre_pike_load` don't.
+// `cpsre_pike_anchored` and `cpsre_pike_unanchored` behave exactly like
+// `cpsre_anchored` and `cpsre_unanchored`. `cpsre_pike_find` returns the
+// beginning of the first partial match and stores its end to `*end`, or null
+// to both, finding both in one run of the vm. `regex` must outlive the `struct
+// cpsre_pike`, which must be freed with `cpsre_pike_free`
+struct cpsre_pike *cpsre_pike(char *regex);
+bool cpsre_pike_linear(struct cpsre_pike *pike);
+char *cpsre_pike_anchored(struct cpsre_pike *pike, char *input, char *target);
+char *cpsre_pike_unanchored(struct cpsre_pike *pike, char *input, char *target);
+char *cpsre_pike_find(struct cpsre_pike *pike, char *input, char **end);
+void cpsre_pike_free(struct cpsre_pike *pike);
+
+// a search that can stop after a number of steps and pick up again later, for
+// callers such as event loops that can't afford to block on a long search.
+// `cpsre_search` starts a search for `pike` in `input`, like
+// `cpsre_pike_unanchored` would, and returns null if it runs out of memory or
+// if `cpsre_pike_linear` rejects `pike`: a single attempt of the backtracker
+// can't be split into steps and can take exponential time, so callers must
+// fall back to it explicitly, say on a thread of its own. `pike`, `input` and
+// `target` must outlive the search, which must be freed with
+// `cpsre_search_free`. `cpsre_search_run` continues the search for at most
+// `steps` steps and returns `CPSRE_PENDING` if it isn't done yet. otherwise it
+// returns 1 and stores the beginning and the end of the match to `*begin` and
+// `*end`, as `cpsre_unanchored` and `cpsre_anchored` would find them, or
+// returns 0 if there is no match, and keeps returning the same thereafter. a
+// step is one character of input, which takes time linear in the length of the
+// regex
+#define CPSRE_PENDING -1
+struct cpsre_search *cpsre_search(struct cpsre_pike *pike, char *input,
+                                  char *target);
+int cpsre_search_run(struct cpsre_search *search, size_t steps, char **begin,
+                     char **end);
+void cpsre_search_free(struct cpsre_search *search);
+
+// a lexer over an ordered list of `nrules` regexes, or rules, which must
+// outlive it. `cpsre_lex` finds the longest nonempty prefix of `input` that a
+// rule matches exactly, stores its length to `*len`, and returns the index of
+// that rule, the lowest one if several match. it returns -1 if no rule matches.
+// rules are run together on a pike vm, in one pass over the input; rules it
+// can't run are left to the backtracker, which has to try every length in
+// turn, up to the longest match the vm finds with their `!` and `&` dropped.
+// `cpsre_lex_next` does the same at `*input` and moves `*input` past the token,
+// so it can be called in a loop until it returns -1, which happens at the end
+// of the input or before input no rule matches. a lexer keeps the buffers of
+// the vm, so it can't be used by several threads at once. `cpsre_lexer` returns
+// null only if it runs out of memory
+struct cpsre_lexer *cpsre_lexer(char **rules, int nrules);
+int cpsre_lex(struct cpsre_lexer *lexer, char *input, size_t *len);
+int cpsre_lex_next(struct cpsre_lexer *lexer, char **input, size_t *len);
+void cpsre_lexer_free(struct cpsre_lexer *lexer);
+
+// a compiled regex can be saved to a buffer and loaded from it later without
+// compiling again. `cpsre_pike_save` writes the compiled regex to `buf` if it
+// holds `size` bytes and returns the number of bytes needed either way. the
+// format is versioned and position-independent, so buffers can be written to
+// files and memory-mapped, but only by builds for the same platform.
+// `cpsre_pike_load` checks the buffer's header, checksum and program without
+// parsing the regex and returns null if they're invalid or if it runs out of
+// memory. the `struct cpsre_pike` it returns uses `buf` directly, so `buf` must
+// be aligned like an `int`, and outlive it and not change
+size_t cpsre_pike_save(struct cpsre_pike *pike, void *buf, size_t size);
+struct cpsre_pike *cpsre_pike_load(void *buf, size_t size);
+
+// replaces every match of `regex` in `input`, from left to right as
+// `cpsre_unanchored` finds them, with `replacement`. in `replacement`, `&`
+// stands for the match, and `\&` and `\\` for `&` and `\`. after an empty
+// match the next character is copied before searching again. ill-formed
+// regexes match nothing. the result is written to `out` like `snprintf` would,
+// and its length is returned, so calling with a `size` of 0 first gives the
+// exact size needed. nothing is allocated. `cpsre_pike_replace` does the same
+// with a precompiled `pike`, which finds every match in a single run of the vm
+size_t cpsre_replace(char *regex, char *input, char *replacement, char *out,
+                     size_t size);
+size_t cpsre_pike_replace(struct cpsre_pike *pike, char *input,
+                          char *replacement, char *out, size_t size);
+
+// matches every line of the `len` bytes at `buf` against `regex`, as
+// `cpsre_unanchored` would, and sets bit `i % 8` of `bitmap[i / 8]` if and only
+// if line `i` matches. lines end with `\n`, which isn't part of them, or with
+// the end of the buffer. returns the number of lines, so `bitmap` needs room
+// for `len / 8 + 1` bytes, or `(size_t)-1` if it runs out of memory. `buf` is
+// modified during the call, but restored before it returns
+size_t cpsre_match_lines(char *regex, char *buf, size_t len,
+                         unsigned char *bitmap);
+
+// rewrites a well-formed `regex` into an equivalent regex that is often faster
+// to match, such as `a*` for `(a*)*` or `a|b` for `(a|b|a)`. greedy quantifiers
+// that backtracking can't benefit from are made possessive, such as in `a*+b`
+// for `a*b`. the result matches exactly what `regex` matches. it is written to
+// `out` like `snprintf` would, and its length is returned. ill-formed regexes
+// are copied unchanged
+size_t cpsre_simplify(char *regex, char *out, size_t size);
+
+// classifies the worst-case time the backtracker takes to match a well-formed
+// `regex` from one position of an input of length `n`. returns `k` if that
+// time is O(n^k), or `CPSRE_EXPONENTIAL`, and stores to `*culprit` a pointer to
+// the subexpression responsible, such as the outer `*` in `(a*)*` or the first
+// loop in `0-9+0-9+`, or null if the time is linear. `cpsre_unanchored` makes
+// one such attempt per position. the analysis is conservative: possessive
+// quantifiers count as greedy ones, and it gives up after a fixed amount of
+// work, bounding its own cost on untrusted regexes, and then deems the regex
+// exponential with a null culprit. returns 0 for ill-formed regexes
+#define CPSRE_EXPONENTIAL -1
+int cpsre_complexity(char *regex, char **culprit);
+
+// `cpsre-gen -t NAME` emits a table `struct cpsre_gen NAME[]` of specialized
+// matchers, terminated by an entry whose `regex` is null. `anchored` and
+// `unanchored` behave like `cpsre_anchored` and `cpsre_unanchored` on `regex`
+struct cpsre_gen {
+  char *regex;
+  char *(*anchored)(char *input, char *target);
+  char *(*unanchored)(char *input, char *target);
+};
@@ -0,0 +1,400 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+extern "C" {
+#include "cps-re.h"
+}
+
+// a c++17 interface to cps-re. `cpsre::regex` owns a regex compiled at runtime
+// and matches `std::string_view`s. `cpsre::static_regex` parses a regex at
+// compile time instead and instantiates a matcher for it, which the compiler
+// can then inline and specialize like any other code. ill-formed regexes fail
+// to compile. both return exactly what `cpsre_anchored` and `cpsre_unanchored`
+// return. like the c interface, they see inputs as ending at their first null
+// character, if any
+
+namespace cpsre {
+
+namespace detail {
+
+// the parser of `parse.h`, over positions in a constant string rather than
+// pointers. `npos` stands for `NULL`. keep in sync with grammar.bnf
+
+inline constexpr std::size_t npos = -1;
+
+constexpr bool is_meta(char chr) {
+  // like `strchr(METACHARS, chr)`, which finds the null terminator too
+  for (const char *meta = "\\-.~%*+?|&!()";; meta++)
+    if (*meta == chr)
+      return true;
+    else if (*meta == '\0')
+      return false;
+}
+
+template <class S>
+constexpr std::size_t parse_symbol(const S &s, std::size_t i) {
+  if (!is_meta(s[i]))
+    return i + 1;
+  if (s[i] == '\\' && s[i + 1] && is_meta(s[i + 1]))
+    return i + 2;
+  return npos; // syntax
+}
+
+template <class S> constexpr std::size_t parse_regex(const S &s, std::size_t i);
+template <class S>
+constexpr std::size_t parse_atom(const S &s, std::size_t i) {
+  if (s[i] == '%')
+    return i + 1;
+  if (s[i] == '(') {
+    if (s[i = parse_regex(s, i + 1)] == ')')
+      return i + 1;
+    return npos; // syntax
+  }
+  if (s[i] == '~')
+    i++;
+  if (s[i] == '.')
+    return i + 1;
+  i = parse_symbol(s, i);
+  if (i != npos && s[i] == '-')
+    return parse_symbol(s, i + 1); // syntax or ok
+  return i;                        // syntax or ok
+}
+
+template <class S>
+constexpr std::size_t parse_factor(const S &s, std::size_t i) {
+  if ((i = parse_atom(s, i)) == npos)
+    return npos; // syntax
+  if (s[i] == '*' || s[i] == '+' || s[i] == '?')
+    if (s[++i] == '+' || s[i] == '?')
+      i++;
+  return i;
+}
+
+template <class S>
+constexpr std::size_t parse_term(const S &s, std::size_t i) {
+  if (s[i] == '!')
+    i++;
+  for (std::size_t term = 0; (term = parse_factor(s, i)) != npos;)
+    i = term;
+  return i;
+}
+
+template <class S>
+constexpr std::size_t parse_regex(const S &s, std::size_t i) {
+  while (i = parse_term(s, i), s[i] == '|' || s[i] == '&')
+    i++;
+  return i;
+}
+
+struct range {
+  char lower, upper;
+  bool negated;
+};
+
+template <class S> constexpr range parse_class(const S &s, std::size_t i) {
+  // the atom at `i`, which is neither `%` nor `(...)`, as a character range,
+  // with wraparound undone
+  bool negated = s[i] == '~';
+  i += negated;
+  if (s[i] == '.')
+    return {CHAR_MIN, CHAR_MAX, negated};
+  char lower = s[i] == '\\' ? s[i + 1] : s[i], upper = lower;
+  if (s[i = parse_symbol(s, i)] == '-')
+    upper = s[i + 1] == '\\' ? s[i + 2] : s[i + 1];
+  if (lower > upper)
+    return {char(upper + 1), char(lower - 1), !negated};
+  return {lower, upper, negated};
+}
+
+constexpr bool more(const char *input, const char *end) {
+  // whether the input goes on at `input`. `end` is null for inputs that end
+  // only at a null character
+  return input != end && *input;
+}
+
+// the backtracker of cps-re.c, with the regex walked at compile time. every
+// node has a `match(input, end, cont)` that calls `cont(pos)` for every
+// position `pos` a match of the node beginning at `input` can end at, in
+// order, and returns true as soon as one of these calls does. returning true
+// stands for the `longjmp` on a match, and returning false for a backtrack
+
+template <const auto &P, std::size_t I> struct regex_node;
+
+template <const auto &P, std::size_t I> struct atom_node {
+  template <class K>
+  static bool match(const char *input, const char *end, const K &cont) {
+    if constexpr (P[I] == '%') {
+      for (;; input++)
+        if (cont(input))
+          return true;
+        else if (!more(input, end))
+          return false;
+    } else if constexpr (P[I] == '(')
+      return regex_node<P, I + 1>::match(input, end, cont);
+    else {
+      constexpr range r = parse_class(P, I);
+      return more(input, end) &&
+             ((r.lower <= *input && *input <= r.upper) ^ r.negated) &&
+             cont(input + 1);
+    }
+  }
+};
+
+template <const auto &P, std::size_t I> struct factor_node {
+  using atom = atom_node<P, I>;
+  static constexpr std::size_t quant = parse_atom(P, I);
+  static constexpr char op = P[quant], mod = op ? P[quant + 1] : '\0';
+
+  template <class K>
+  static bool greedy(const char *input, const char *end, const K &cont) {
+    return atom::match(input, end,
+                       [&](const char *pos) {
+                         return pos != input && greedy(pos, end, cont);
+                       }) ||
+           cont(input);
+  }
+
+  template <class K>
+  static bool lazy(const char *input, const char *end, const K &cont) {
+    return cont(input) || atom::match(input, end, [&](const char *pos) {
+             return pos != input && lazy(pos, end, cont);
+           });
+  }
+
+  template <class K>
+  static bool possessive(const char *input, const char *end, const K &cont,
+                         bool &committed) {
+    // once the continuation has been called, we've committed to it, and
+    // everything else the quantifier could have tried is abandoned
+    if (atom::match(input, end, [&](const char *pos) {
+          return !committed && pos != input &&
+                 possessive(pos, end, cont, committed);
+        }))
+      return true;
+    return !committed && (committed = true, cont(input));
+  }
+
+  template <class K>
+  static bool match(const char *input, const char *end, const K &cont) {
+    bool committed = false;
+    if constexpr (op == '*' && mod == '+')
+      return possessive(input, end, cont, committed);
+    else if constexpr (op == '*' && mod == '?')
+      return lazy(input, end, cont);
+    else if constexpr (op == '*')
+      return greedy(input, end, cont);
+    else if constexpr (op == '+' && mod == '+')
+      return atom::match(input, end, [&](const char *pos) {
+        return !committed && possessive(pos, end, cont, committed);
+      });
+    else if constexpr (op == '+' && mod == '?')
+      return atom::match(input, end, [&](const char *pos) {
+        return lazy(pos, end, cont);
+      });
+    else if constexpr (op == '+')
+      return atom::match(input, end, [&](const char *pos) {
+        return greedy(pos, end, cont);
+      });
+    else if constexpr (op == '?' && mod == '+')
+      return atom::match(input, end,
+                         [&](const char *pos) {
+                           return !committed && (committed = true, cont(pos));
+                         }) ||
+             (!committed && cont(input));
+    else if constexpr (op == '?' && mod == '?')
+      return cont(input) || atom::match(input, end, cont);
+    else if constexpr (op == '?')
+      return atom::match(input, end, cont) || cont(input);
+    else
+      return atom::match(input, end, cont);
+  }
+};
+
+template <const auto &P, std::size_t I> struct factors_node {
+  // the factors of a term from `I` on
+  static constexpr std::size_t next = parse_factor(P, I);
+
+  template <class K>
+  static bool match(const char *input, const char *end, const K &cont) {
+    if constexpr (next == npos)
+      return cont(input);
+    else
+      return factor_node<P, I>::match(input, end, [&](const char *pos) {
+        return factors_node<P, next>::match(pos, end, cont);
+      });
+  }
+};
+
+template <const auto &P, std::size_t I> struct term_node {
+  template <class K>
+  static bool match(const char *input, const char *end, const K &cont) {
+    if constexpr (P[I] == '!') {
+      // see `match_term`
+      for (const char *target = input;; target++)
+        if (!factors_node<P, I + 1>::match(
+                input, end, [&](const char *pos) { return pos == target; }) &&
+            cont(target))
+          return true;
+        else if (!more(target, end))
+          return false;
+    } else
+      return factors_node<P, I>::match(input, end, cont);
+  }
+};
+
+template <const auto &P, std::size_t I> struct regex_node {
+  // alternation and intersection are right-associative
+  using term = term_node<P, I>;
+  static constexpr std::size_t binop = parse_term(P, I);
+
+  template <class K>
+  static bool match(const char *input, const char *end, const K &cont) {
+    using rest = regex_node<P, binop + 1>;
+    if constexpr (P[binop] == '|')
+      return term::match(input, end, cont) || rest::match(input, end, cont);
+    else if constexpr (P[binop] == '&')
+      return term::match(input, end, [&](const char *pos) {
+        return rest::match(input, end,
+                           [&](const char *rhs) { return rhs == pos; }) &&
+               cont(pos);
+      });
+    else
+      return term::match(input, end, cont);
+  }
+};
+
+struct no_match {
+  // what ill-formed regexes compile to, to keep the compiler from going on
+  // after the `static_assert` below
+  template <class K>
+  static bool match(const char *, const char *, const K &) {
+    return false;
+  }
+};
+
+inline thread_local std::string buffer; // for null-terminated copies of input
+
+inline char *terminate(std::string_view input) {
+  buffer.assign(input.data(), input.size());
+  return buffer.data();
+}
+
+} // namespace detail
+
+// a regex known at compile time, such as `static constexpr char r[] = "a*b"`,
+// or in c++20 a string literal through `cpsre::literal`. `anchored` and
+// `unanchored` behave exactly like `cpsre_anchored` and `cpsre_unanchored`.
+// `match` tells whether `input` matches exactly, and `search` returns the
+// first partial match, like `cpsre_unanchored` and then `cpsre_anchored` find
+template <const auto &P> struct static_regex {
+  static constexpr bool well_formed = P[detail::parse_regex(P, 0)] == '\0';
+  static_assert(well_formed, "ill-formed regular expression");
+  using node = std::conditional_t<well_formed, detail::regex_node<P, 0>,
+                                  detail::no_match>;
+
+  static const char *anchored(const char *input, const char *target,
+                              const char *end = nullptr) {
+    const char *match = nullptr;
+    node::match(input, end, [&](const char *pos) {
+      return (target == nullptr || pos == target) && (match = pos);
+    });
+    return match;
+  }
+
+  static const char *unanchored(const char *input, const char *target,
+                                const char *end = nullptr) {
+    for (;; input++)
+      if (anchored(input, target, end) != nullptr)
+        return input;
+      else if (!detail::more(input, end))
+        return nullptr;
+  }
+
+  static bool match(std::string_view input) {
+    const char *end = input.data() + input.size();
+    return anchored(input.data(), end, end) != nullptr;
+  }
+
+  static std::optional<std::string_view> search(std::string_view input) {
+    const char *end = input.data() + input.size();
+    const char *begin = unanchored(input.data(), nullptr, end);
+    if (begin == nullptr)
+      return std::nullopt;
+    return std::string_view(begin, anchored(begin, nullptr, end) - begin);
+  }
+};
+
+#if __cplusplus >= 202002L
+template <std::size_t N> struct fixed_string {
+  char chars[N];
+  constexpr fixed_string(const char (&s)[N]) {
+    for (std::size_t i = 0; i < N; i++)
+      chars[i] = s[i];
+  }
+  constexpr char operator[](std::size_t i) const { return chars[i]; }
+};
+
+template <fixed_string S> struct holder {
+  static constexpr fixed_string value = S;
+};
+
+// `cpsre::literal<"a*b">` is a `static_regex` for `a*b`
+template <fixed_string S> using literal = static_regex<holder<S>::value>;
+#endif
+
+// a regex only known at runtime, run by `cpsre_pike`. the constructor throws
+// `std::invalid_argument` if `pattern` is ill-formed and `std::bad_alloc` if it
+// runs out of memory. inputs are copied to be null-terminated
+class regex {
+public:
+  explicit regex(std::string_view pattern)
+      : chars(new char[pattern.size() + 1]) {
+    pattern.copy(chars.get(), pattern.size()), chars[pattern.size()] = '\0';
+    if (cpsre_parse(chars.get()) != chars.get() + pattern.size())
+      throw std::invalid_argument("ill-formed regular expression");
+    if ((pike = decltype(pike)(cpsre_pike(chars.get()))) == nullptr)
+      throw std::bad_alloc();
+  }
+
+  const char *anchored(const char *input, const char *target) const {
+    return cpsre_pike_anchored(pike.get(), const_cast<char *>(input),
+                               const_cast<char *>(target));
+  }
+
+  const char *unanchored(const char *input, const char *target) const {
+    return cpsre_pike_unanchored(pike.get(), const_cast<char *>(input),
+                                 const_cast<char *>(target));
+  }
+
+  bool match(std::string_view input) const {
+    char *copy = detail::terminate(input);
+    return anchored(copy, copy + input.size()) != nullptr;
+  }
+
+  std::optional<std::string_view> search(std::string_view input) const {
+    // both ends of the match come from one run of the vm
+    char *copy = detail::terminate(input), *end;
+    const char *begin = cpsre_pike_find(pike.get(), copy, &end);
+    if (begin == nullptr)
+      return std::nullopt;
+    return input.substr(begin - copy, end - begin);
+  }
+
+private:
+  struct deleter {
+    void operator()(struct cpsre_pike *pike) const { cpsre_pike_free(pike); }
+  };
+  // the pike refers to the regex, so it must not move when we do
+  std::unique_ptr<char[]> chars;
+  std::unique_ptr<struct cpsre_pike, deleter> pike;
+};
+
+} // namespace cpsre
@@ -0,0 +1,520 @@
+#include "cps-re.h"
+#include "parse.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// an ahead-of-time code generator. `cps-re.c` interprets a regular expression
+// from its text on every call; this tool instead partially evaluates that
+// interpreter with respect to a fixed regular expression and emits the result
+// as C. every `match_...` and `rep_...` function of the interpreter, together
+// with the position in the regex it would be called with, becomes its own
+// specialized function. atom checks get folded into constant comparisons, and
+// wherever the interpreter would allocate a continuation whose function is
+// known at generation time, the generated code calls that function directly
+// instead, which lets the C compiler inline most of the matcher. the emitted
+// functions have exactly the semantics of `cpsre_anchored` and
+// `cpsre_unanchored` for that regex
+
+// the specialized functions we can emit. each is identified by its kind and by
+// the offset into the regex it was specialized for
+enum kind { REGEX, TERM, STAR, LAZY, POSS, AND, ANCHORED, KINDS };
+static const char *kind_names[KINDS] = {"regex", "term", "star", "lazy",
+                                        "poss",  "and",  "anchored"};
+
+static char *regex;         // the regex currently being generated
+static char *name;          // prefix for the functions of the current regex
+static bool *wanted[KINDS]; // which functions have been referenced
+static bool *emitted[KINDS];
+static FILE *out;
+
+static bool use_poss_jmp, use_found_match, use_require_progress,
+    use_commit_possessive;
+
+static char *fn(enum kind kind, char *at) {
+  // reference the function of kind `kind` specialized for `at`, making sure it
+  // eventually gets emitted. the returned string is valid until the next call
+  static char buf[2][256];
+  static int i;
+  wanted[kind][at - regex] = true, i = !i;
+  if (snprintf(buf[i], sizeof(buf[i]), "%s_%s_%d", name, kind_names[kind],
+               (int)(at - regex)) >= (int)sizeof(buf[i]))
+    fprintf(stderr, "cpsre-gen: name too long: %s\n", name),
+        exit(EXIT_FAILURE);
+  return buf[i];
+}
+
+// how to proceed once an atom has matched. this mirrors the continuations the
+// interpreter would allocate, but lets us call `fn` directly when possible:
+// - `THEN` calls `fn` with continuation `cont`
+// - `PROGRESS` does the same, but only if input was consumed since the atom
+//   began matching (`require_progress`)
+// - `COMMIT` does the same but locks in a possessive (`commit_possessive`)
+struct then {
+  enum { THEN, PROGRESS, COMMIT } how;
+  enum kind kind;
+  char *at;
+};
+
+static void emit_call(struct then then, char *input, bool consumed) {
+  // emit a statement that runs `then` at input position `input`. if `consumed`
+  // is true, `input` is known to differ from where the atom began matching
+  if (then.how == PROGRESS && !consumed)
+    fprintf(out, "    if (%s != input)\n  ", input);
+  if (then.how == COMMIT)
+    fprintf(out, "    {\n      UNSETJMP(poss_jmp) { ");
+  else
+    fprintf(out, "    ");
+  fprintf(out, "%s(NULL, %s, cont);", fn(then.kind, then.at), input);
+  if (then.how == COMMIT)
+    fprintf(out, " }\n      LONGJMP(poss_jmp);\n    }");
+  fprintf(out, "\n");
+}
+
+static void emit_cont(struct then then) {
+  // emit a continuation that does what `then` describes, for when we can't
+  // call it directly
+  if (then.how == PROGRESS)
+    use_require_progress = true, fprintf(out, "CONT(require_progress, input, ");
+  if (then.how == COMMIT)
+    use_commit_possessive = true,
+    fprintf(out, "CONT(commit_possessive, NULL, ");
+  fprintf(out, "CONT(%s, NULL, cont)", fn(then.kind, then.at));
+  if (then.how != THEN)
+    fprintf(out, ")");
+}
+
+static bool is_alnum(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9');
+}
+
+static bool is_identifier(char *str) {
+  // whether `str` is a valid c identifier, as `NAME` must be
+  if (!(is_alnum(*str) || *str == '_') || (*str >= '0' && *str <= '9'))
+    return false;
+  while (is_alnum(*str) || *str == '_')
+    str++;
+  return *str == '\0';
+}
+
+static void emit_char(char c) {
+  if (is_alnum(c))
+    fprintf(out, "'%c'", c);
+  else
+    fprintf(out, "'\\%03o'", (unsigned char)c);
+}
+
+static void emit_class(char *atom) {
+  // emit a condition that holds if `*input` is in the character class `atom`.
+  // bounds that every `char` satisfies are left out
+  char lower, upper;
+  bool compl;
+  parse_class(atom, &lower, &upper, &compl);
+
+  fprintf(out, "*input && %s(", compl ? "!" : "");
+  if (lower == upper)
+    fprintf(out, "*input == "), emit_char(lower);
+  else if (lower == CHAR_MIN && upper == CHAR_MAX)
+    fprintf(out, "1");
+  else if (lower == CHAR_MIN)
+    fprintf(out, "*input <= "), emit_char(upper);
+  else if (upper == CHAR_MAX)
+    fprintf(out, "*input >= "), emit_char(lower);
+  else
+    emit_char(lower), fprintf(out, " <= *input && *input <= "),
+        emit_char(upper);
+  fprintf(out, ")");
+}
+
+static void emit_atom(char *atom, struct then then) {
+  // emit the body of `match_atom(atom, input, <then>)`
+  if (*atom == '%') {
+    fprintf(out, "  for (char *in = input;; in++) {\n");
+    emit_call(then, "in", false);
+    fprintf(out, "    if (!*in)\n      break;\n  }\n");
+    return;
+  }
+
+  if (*atom == '(') {
+    fprintf(out, "  %s(NULL, input, ", fn(REGEX, atom + 1));
+    emit_cont(then), fprintf(out, ");\n");
+    return;
+  }
+
+  fprintf(out, "  if ("), emit_class(atom), fprintf(out, ")\n");
+  emit_call(then, "input + 1", true);
+}
+
+static void emit_header(enum kind kind, char *at) {
+  fprintf(out,
+          "\nstatic void %s(char *regex, char *input, struct cont *cont) {\n",
+          fn(kind, at));
+}
+
+static void emit_term(char *term) {
+  // emit `match_term` specialized for `term`
+  emit_header(TERM, term);
+
+  if (*term == '!' && term[1] != '!') {
+    use_found_match = true;
+    fprintf(out, "  char *target = input;\n"
+                 "  do {\n"
+                 "    SETJMP(match_jmp) {\n"
+                 "      %s(NULL, input, CONT(found_match, target, NULL));\n"
+                 "      UNSETJMP(match_jmp) { cont->fp(cont->regex, target, "
+                 "cont->up); }\n"
+                 "    }\n"
+                 "  } while (*target++);\n}\n",
+            fn(TERM, term + 1));
+    return;
+  }
+
+  char *next = parse_factor(term);
+  if (next == NULL || *next == '!') {
+    fprintf(out, "  cont->fp(cont->regex, input, cont->up);\n}\n");
+    return;
+  }
+
+  char *quant = parse_atom(term);
+  bool poss = *quant && strchr("*+?", *quant) && quant[1] == '+';
+  bool lazy = *quant && strchr("*+?", *quant) && quant[1] == '?';
+  struct then then = {THEN, TERM, next};
+  use_poss_jmp |= poss;
+
+  switch (*quant) {
+  case '*':
+    if (!poss)
+      fprintf(out, "  %s(NULL, input, cont);\n", fn(lazy ? LAZY : STAR, term));
+    else
+      fprintf(out, "  SETJMP(poss_jmp) { %s(NULL, input, cont); }\n",
+              fn(POSS, term));
+    break;
+  case '+':
+    if (!poss)
+      emit_atom(term, (struct then){THEN, lazy ? LAZY : STAR, term});
+    else
+      fprintf(out, "  SETJMP(poss_jmp) {\n"),
+          emit_atom(term, (struct then){THEN, POSS, term}),
+          fprintf(out, "  }\n");
+    break;
+  case '?':
+    if (!poss && lazy)
+      fprintf(out, "  %s(NULL, input, cont);\n", fn(TERM, next)),
+          emit_atom(term, then);
+    else if (!poss)
+      emit_atom(term, then),
+          fprintf(out, "  %s(NULL, input, cont);\n", fn(TERM, next));
+    else
+      fprintf(out, "  SETJMP(poss_jmp) {\n"),
+          emit_atom(term, (struct then){COMMIT, TERM, next}),
+          fprintf(out, "  UNSETJMP(poss_jmp) { %s(NULL, input, cont); }\n  }\n",
+                  fn(TERM, next));
+    break;
+  default:
+    emit_atom(term, then);
+    break;
+  }
+  fprintf(out, "}\n");
+}
+
+static void emit_rep(enum kind kind, char *atom) {
+  // emit `rep_greedy`, `rep_lazy` or `rep_poss` specialized for `atom`, with
+  // the continuation being the rest of the term the repetition belongs to
+  char *next = parse_factor(atom);
+  emit_header(kind, atom);
+  if (kind == LAZY)
+    fprintf(out, "  %s(NULL, input, cont);\n", fn(TERM, next));
+  // a possessive repetition never returns, as it ends with a `LONGJMP`, so
+  // rather than recursing after every character of a class, which compilers
+  // warn is infinite recursion, we loop
+  if (kind == POSS && is_class(atom))
+    fprintf(out, "  while ("), emit_class(atom),
+        fprintf(out, ")\n    input++;\n");
+  else
+    emit_atom(atom, (struct then){PROGRESS, kind, atom});
+  if (kind == STAR)
+    fprintf(out, "  %s(NULL, input, cont);\n", fn(TERM, next));
+  if (kind == POSS)
+    fprintf(out, "  UNSETJMP(poss_jmp) { %s(NULL, input, cont); }\n"
+                 "  LONGJMP(poss_jmp);\n",
+            fn(TERM, next));
+  fprintf(out, "}\n");
+}
+
+static void emit_regex(char *sub) {
+  // emit `match_regex` specialized for `sub`
+  char *binop = parse_term(sub);
+  emit_header(REGEX, sub);
+  if (*binop == '|')
+    fprintf(out, "  %s(NULL, input, cont);\n", fn(TERM, sub)),
+        fprintf(out, "  %s(NULL, input, cont);\n", fn(REGEX, binop + 1));
+  else if (*binop == '&')
+    fprintf(out, "  %s(NULL, input, CONT(", fn(TERM, sub)),
+        fprintf(out, "%s, input, cont));\n", fn(AND, binop + 1));
+  else
+    fprintf(out, "  %s(NULL, input, cont);\n", fn(TERM, sub));
+  fprintf(out, "}\n");
+}
+
+static void emit_and(char *rhs) {
+  // emit `int_rhs` specialized for `rhs`. unlike the interpreter we store the
+  // input position before the match in our own continuation's `regex` field
+  emit_header(AND, rhs);
+  fprintf(out, "  if (%s(regex, input) != NULL)\n", fn(ANCHORED, rhs));
+  fprintf(out, "    cont->fp(cont->regex, input, cont->up);\n}\n");
+}
+
+static void emit_anchored(char *sub) {
+  // emit `cpsre_anchored` specialized for `sub`
+  use_found_match = true;
+  fprintf(out,
+          "\nstatic char *%s(char *input, char *target) {\n"
+          "  SETJMP(match_jmp) {\n",
+          fn(ANCHORED, sub));
+  fprintf(out,
+          "    %s(NULL, input, CONT(found_match, target, NULL));\n"
+          "    UNSETJMP(match_jmp) { return NULL; }\n"
+          "  }\n\n"
+          "  return match_end;\n}\n",
+          fn(REGEX, sub));
+}
+
+static void emit_matcher(char *re, char *prefix) {
+  // emit `<prefix>_anchored` and `<prefix>_unanchored` for `re`, along with
+  // all the specialized functions they transitively reference
+  size_t len = strlen(re) + 1;
+  regex = re, name = prefix;
+  for (int kind = 0; kind < KINDS; kind++) {
+    wanted[kind] = calloc(len, sizeof(bool));
+    emitted[kind] = calloc(len, sizeof(bool));
+    if (wanted[kind] == NULL || emitted[kind] == NULL)
+      perror("calloc"), exit(EXIT_FAILURE);
+  }
+
+  fn(ANCHORED, regex);
+  for (bool progress = true; progress;) {
+    progress = false;
+    for (int kind = 0; kind < KINDS; kind++)
+      for (size_t i = 0; i < len; i++) {
+        if (!wanted[kind][i] || emitted[kind][i])
+          continue;
+        emitted[kind][i] = progress = true;
+        switch (kind) {
+        case REGEX:
+          emit_regex(regex + i);
+          break;
+        case TERM:
+          emit_term(regex + i);
+          break;
+        case AND:
+          emit_and(regex + i);
+          break;
+        case ANCHORED:
+          emit_anchored(regex + i);
+          break;
+        default:
+          emit_rep(kind, regex + i);
+          break;
+        }
+      }
+  }
+
+  fprintf(out,
+          "\nchar *%s_anchored(char *input, char *target) {\n"
+          "  return %s(input, target);\n}\n",
+          name, fn(ANCHORED, regex));
+  fprintf(out,
+          "\nchar *%s_unanchored(char *input, char *target) {\n"
+          "  do {\n"
+          "    if (%s(input, target) != NULL)\n"
+          "      return input;\n"
+          "  } while (*input++);\n\n"
+          "  return NULL;\n}\n",
+          name, fn(ANCHORED, regex));
+
+  for (int kind = 0; kind < KINDS; kind++)
+    free(wanted[kind]), free(emitted[kind]);
+}
+
+static void emit_prototypes(FILE *body) {
+  // every specialized function in `body` gets a prototype, so they can appear
+  // in any order. we recover them from the function headers themselves
+  char line[512];
+  rewind(body);
+  while (fgets(line, sizeof(line), body))
+    if (strncmp(line, "static ", 7) == 0)
+      *strchr(line, ')') = '\0', printf("%s);\n", line);
+}
+
+static void emit_string(char *str) {
+  // emit `str` as a C string literal. we escape everything that could possibly
+  // be misinterpreted, including `?` to avoid trigraphs
+  putchar('"');
+  for (; *str; str++)
+    if (is_alnum(*str))
+      putchar(*str);
+    else
+      printf("\\%03o", (unsigned char)*str);
+  putchar('"');
+}
+
+static char prelude[] =
+    "#include <setjmp.h>\n"
+    "#include <stddef.h>\n"
+    "\n"
+    "// see cps-re.c for how all of this works\n"
+    "\n"
+    "#define CONT(...) (&(struct cont){__VA_ARGS__})\n"
+    "struct cont {\n"
+    "  void (*fp)(char *regex, char *input, struct cont *cont);\n"
+    "  char *regex;\n"
+    "  struct cont *up;\n"
+    "};\n"
+    "\n"
+    "struct jmplist {\n"
+    "  jmp_buf jmp_buf;\n"
+    "  struct jmplist *up;\n"
+    "};\n"
+    "\n"
+    "#define SETJMP(JMPLIST) \\\n"
+    "  for (struct jmplist *_jmp = &(struct jmplist){.up = JMPLIST}; _jmp;)"
+    " \\\n"
+    "    for (JMPLIST = _jmp; _jmp; JMPLIST = _jmp->up, _jmp = NULL) \\\n"
+    "      if (setjmp(_jmp->jmp_buf) == 0)\n"
+    "\n"
+    "#define UNSETJMP(JMPLIST) \\\n"
+    "  for (struct jmplist *_jmp = JMPLIST; _jmp;) \\\n"
+    "    for (JMPLIST = JMPLIST->up; _jmp; JMPLIST = _jmp, _jmp = NULL)\n"
+    "\n"
+    "#define LONGJMP(JMPLIST) longjmp(JMPLIST->jmp_buf, 1)\n"
+    "\n"
+    "#if __STDC_VERSION__ >= 201112L\n"
+    "#define THREAD_LOCAL _Thread_local\n"
+    "#else\n"
+    "#define THREAD_LOCAL __thread\n"
+    "#endif\n"
+    "\n"
+    "static THREAD_LOCAL char *match_end;\n"
+    "static THREAD_LOCAL struct jmplist *match_jmp;\n";
+
+static char found_match[] =
+    "\nstatic void found_match(char *target, char *input, struct cont *_cont)"
+    " {\n"
+    "  if (target == NULL || input == target)\n"
+    "    match_end = input, LONGJMP(match_jmp);\n"
+    "}\n";
+
+static char require_progress[] =
+    "\nstatic void require_progress(char *prev_input, char *input,\n"
+    "                             struct cont *cont) {\n"
+    "  if (input != prev_input)\n"
+    "    cont->fp(cont->regex, input, cont->up);\n"
+    "}\n";
+
+static char commit_possessive[] =
+    "\nstatic void commit_possessive(char *_regex, char *input, struct cont "
+    "*cont) {\n"
+    "  UNSETJMP(poss_jmp) { cont->fp(cont->regex, input, cont->up); }\n"
+    "  LONGJMP(poss_jmp);\n"
+    "}\n";
+
+int main(int argc, char **argv) {
+  bool table = argc == 3 && strcmp(argv[1], "-t") == 0;
+  if (argc != 3) {
+    fprintf(stderr,
+            "usage: %s NAME REGEX\n"
+            "       %s -t NAME < REGEXES\n"
+            "emit C functions `NAME_anchored` and `NAME_unanchored` that\n"
+            "match REGEX like `cpsre_anchored` and `cpsre_unanchored` would.\n"
+            "with -t, read null-terminated REGEXES from standard input\n"
+            "instead and emit `NAME_<i>_...` for each, plus a null-\n"
+            "terminated table `struct cpsre_gen NAME[]` of them\n",
+            argv[0], argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // read every regex up front, so that a syntax error produces no output
+  char **regexes = NULL;
+  size_t count = 0;
+  if (!table)
+    regexes = &argv[2], count = 1;
+  else {
+    size_t len = 0, cap = 0;
+    char *buf = NULL;
+    for (int c; (c = getchar()) != EOF;) {
+      if (len == cap && (buf = realloc(buf, cap = cap * 2 + 4096)) == NULL)
+        perror("realloc"), exit(EXIT_FAILURE);
+      buf[len++] = c;
+    }
+    if (len && buf[len - 1] != '\0')
+      fprintf(stderr, "%s: last regex is not null-terminated\n", argv[0]),
+          exit(EXIT_FAILURE);
+    for (size_t i = 0; i < len; i += strlen(buf + i) + 1) {
+      size_t j = 0;
+      while (j < count && strcmp(regexes[j], buf + i) != 0)
+        j++;
+      if (j < count)
+        continue; // duplicate
+      if ((regexes = realloc(regexes, ++count * sizeof(*regexes))) == NULL)
+        perror("realloc"), exit(EXIT_FAILURE);
+      regexes[count - 1] = buf + i;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++)
+    if (*cpsre_parse(regexes[i]) != '\0')
+      fprintf(stderr, "%s: syntax error in regex %zu at offset %d\n", argv[0],
+              i, (int)(cpsre_parse(regexes[i]) - regexes[i])),
+          exit(EXIT_FAILURE);
+
+  if ((out = tmpfile()) == NULL)
+    perror("tmpfile"), exit(EXIT_FAILURE);
+  char *base = table ? argv[2] : argv[1];
+  if (!is_identifier(base))
+    fprintf(stderr, "%s: NAME must be a C identifier: %s\n", argv[0], base),
+        exit(EXIT_FAILURE);
+  char *prefix = malloc(strlen(base) + 32);
+  if (prefix == NULL)
+    perror("malloc"), exit(EXIT_FAILURE);
+  for (size_t i = 0; i < count; i++) {
+    if (table)
+      sprintf(prefix, "%s_%zu", base, i);
+    else
+      strcpy(prefix, base);
+    fprintf(out, "\n// ");
+    for (char *c = regexes[i]; *c; c++)
+      fputc(*c >= ' ' && *c <= '~' && *c != '\\' ? *c : '?', out);
+    fprintf(out, "\n");
+    emit_matcher(regexes[i], prefix);
+  }
+
+  printf("// generated by cpsre-gen. do not edit\n\n");
+  if (table)
+    printf("#include \"cps-re.h\"\n");
+  printf("%s", prelude);
+  if (use_poss_jmp)
+    printf("static THREAD_LOCAL struct jmplist *poss_jmp;\n");
+  printf("\n");
+  emit_prototypes(out);
+  if (use_found_match)
+    printf("%s", found_match);
+  if (use_require_progress)
+    printf("%s", require_progress);
+  if (use_commit_possessive)
+    printf("%s", commit_possessive);
+
+  rewind(out);
+  for (int c; (c = fgetc(out)) != EOF;)
+    putchar(c);
+
+  if (table) {
+    printf("\nstruct cpsre_gen %s[] = {\n", base);
+    for (size_t i = 0; i < count; i++)
+      printf("    {"), emit_string(regexes[i]),
+          printf(", %s_%zu_anchored, %s_%zu_unanchored},\n", base, i, base,
+                 i);
+    printf("    {NULL, NULL, NULL},\n};\n");
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,354 @@
+#define _DEFAULT_SOURCE // for `MAP_ANONYMOUS`, `getopt` and `clock_gettime`
+#include "cps-re.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// a grep-like tool. files are memory-mapped read-only and split into chunks of
+// whole lines, which worker threads then match line by line. the engines want
+// null-terminated input, so every worker copies one line at a time to a buffer
+// of its own; writing terminators into the mapping instead would give every
+// page a private copy, and resident memory would grow to the size of the file.
+// matches are printed in order regardless of which thread found them. lines
+// containing null characters are matched up to the first one
+
+#define CHUNK (1 << 20) // bytes of input per job, give or take a line
+#define MAX_THREADS 1024
+
+struct file {
+  char *name;
+  char *data; // followed by a null terminator
+  size_t size, map_size;
+  size_t count; // number of lines selected
+};
+
+struct job {
+  struct file *file;
+  char *begin, *end; // whole lines of `file`
+  size_t lines, selected;
+  char *out; // what to print, once `done`
+  size_t out_len, out_cap;
+  bool done, oom;
+};
+
+static struct {
+  bool count, invert, exact, summary, dump;
+  char *engine;
+  struct cpsre_jit *jit;
+  struct cpsre_pike *pike;
+  char *regex;
+} opts;
+
+static struct job *jobs;
+static size_t njobs, next_job;
+static bool prefix; // whether to prefix lines with file names
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static bool match_line(char *line, char *end) {
+  // `-x` matches /regex/ and otherwise we match /%regex%/, see cps-re.h
+  char *target = opts.exact ? end : NULL;
+  if (opts.jit)
+    return (opts.exact ? cpsre_jit_anchored(opts.jit, line, target)
+                       : cpsre_jit_unanchored(opts.jit, line, target)) != NULL;
+  if (opts.pike)
+    return (opts.exact ? cpsre_pike_anchored(opts.pike, line, target)
+                       : cpsre_pike_unanchored(opts.pike, line, target)) !=
+           NULL;
+  return (opts.exact ? cpsre_anchored(opts.regex, line, target)
+                     : cpsre_unanchored(opts.regex, line, target)) != NULL;
+}
+
+static void append(struct job *job, char *str, size_t len) {
+  if (job->out_len + len > job->out_cap) {
+    size_t cap = (job->out_cap + len) * 2;
+    char *out = realloc(job->out, cap);
+    if (out == NULL) {
+      job->oom = true;
+      return;
+    }
+    job->out = out, job->out_cap = cap;
+  }
+  memcpy(job->out + job->out_len, str, len);
+  job->out_len += len;
+}
+
+static void run_job(struct job *job, char **buf, size_t *cap) {
+  // `*buf` holds `*cap` bytes and grows to fit the longest line
+  for (char *line = job->begin; line < job->end;) {
+    char *end = memchr(line, '\n', job->end - line);
+    if (end == NULL)
+      end = job->end; // last line of the file
+    size_t len = end - line;
+    if (len >= *cap) {
+      char *grown = realloc(*buf, len * 2 + 1);
+      if (grown == NULL) {
+        job->oom = true;
+        return;
+      }
+      *buf = grown, *cap = len * 2 + 1;
+    }
+    memcpy(*buf, line, len), (*buf)[len] = '\0';
+
+    job->lines++;
+    if (match_line(*buf, *buf + len) != opts.invert) {
+      job->selected++;
+      if (!opts.count) {
+        if (prefix)
+          append(job, job->file->name, strlen(job->file->name)),
+              append(job, ":", 1);
+        append(job, line, end - line), append(job, "\n", 1);
+      }
+    }
+    line = end + 1;
+  }
+}
+
+static void *worker(void *arg) {
+  char *buf = NULL;
+  size_t cap = 0;
+  while (1) {
+    pthread_mutex_lock(&mutex);
+    size_t i = next_job++;
+    pthread_mutex_unlock(&mutex);
+    if (i >= njobs)
+      return free(buf), arg;
+
+    run_job(&jobs[i], &buf, &cap);
+
+    pthread_mutex_lock(&mutex);
+    jobs[i].done = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+  }
+}
+
+static bool map_file(struct file *file) {
+  // map `file->name` with a null terminator after it. we reserve one more byte
+  // than the file holds and then map the file over the reservation, so the
+  // null terminator exists even when the file's size is a multiple of the page
+  // size. `-` means standard input, which we read instead
+  if (strcmp(file->name, "-") == 0) {
+    size_t cap = 0;
+    char *data;
+    file->data = NULL, file->size = 0;
+    do {
+      if (file->size == cap) {
+        if ((data = realloc(file->data, (cap = cap * 2 + CHUNK) + 1)) == NULL)
+          return free(file->data), false;
+        file->data = data;
+      }
+      file->size += fread(file->data + file->size, 1, cap - file->size, stdin);
+    } while (!feof(stdin) && !ferror(stdin));
+    file->data[file->size] = '\0';
+    if (ferror(stdin))
+      return free(file->data), false;
+    return true;
+  }
+
+  int fd = open(file->name, O_RDONLY);
+  struct stat st;
+  if (fd < 0)
+    return false;
+  if (fstat(fd, &st) < 0)
+    return close(fd), false;
+
+  file->size = st.st_size, file->map_size = file->size + 1;
+  file->data = mmap(NULL, file->map_size, PROT_READ,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (file->data == MAP_FAILED)
+    return close(fd), false;
+  if (file->size && mmap(file->data, file->size, PROT_READ,
+                         MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    return munmap(file->data, file->map_size), close(fd), false;
+  close(fd);
+  madvise(file->data, file->map_size, MADV_SEQUENTIAL);
+  return true;
+}
+
+static void add_jobs(struct file *file) {
+  // split `file` into jobs of roughly `CHUNK` bytes that end on line endings
+  char *data = file->data, *end = data + file->size;
+  while (data < end) {
+    char *split = end - data > CHUNK ? data + CHUNK : end;
+    if (split < end && (split = memchr(split, '\n', end - split)) != NULL)
+      split++;
+    else
+      split = end;
+    if ((njobs & (njobs - 1)) == 0 &&
+        (jobs = realloc(jobs, (njobs ? njobs * 2 : 1) * sizeof(*jobs))) ==
+            NULL)
+      perror("realloc"), exit(2);
+    jobs[njobs++] = (struct job){.file = file, .begin = data, .end = split};
+    data = split;
+  }
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+  long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  nthreads = nthreads < 1 ? 1 : nthreads > MAX_THREADS ? MAX_THREADS : nthreads;
+  opts.engine = "auto";
+
+  for (int opt; (opt = getopt(argc, argv, "cvxsdj:e:")) != -1;)
+    switch (opt) {
+    case 'c':
+      opts.count = true;
+      break;
+    case 'v':
+      opts.invert = true;
+      break;
+    case 'x':
+      opts.exact = true;
+      break;
+    case 's':
+      opts.summary = true;
+      break;
+    case 'd':
+      opts.dump = true;
+      break;
+    case 'j':
+      nthreads = atol(optarg);
+      break;
+    case 'e':
+      opts.engine = optarg;
+      break;
+    default:
+      goto usage;
+    }
+
+  if (optind >= argc || nthreads < 1 || nthreads > MAX_THREADS ||
+      (strcmp(opts.engine, "auto") != 0 && strcmp(opts.engine, "cps") != 0 &&
+       strcmp(opts.engine, "pike") != 0 && strcmp(opts.engine, "jit") != 0)) {
+  usage:
+    fprintf(stderr,
+            "usage: %s [-cvxsd] [-j THREADS] [-e ENGINE] REGEX [FILE...]\n"
+            "print lines of FILEs (or of standard input) that contain a match\n"
+            "for REGEX.\n"
+            "  -c  print the number of selected lines instead\n"
+            "  -v  select lines that don't match instead\n"
+            "  -x  only match whole lines\n"
+            "  -s  print throughput to standard error\n"
+            "  -d  print the simplified REGEX to standard error\n"
+            "  -j  number of threads to use, at most %d\n"
+            "  -e  one of `cps` (the backtracker), `pike`, `jit` or `auto`\n",
+            argv[0], MAX_THREADS);
+    return 2;
+  }
+
+  opts.regex = argv[optind++];
+  if (*cpsre_parse(opts.regex) != '\0') {
+    fprintf(stderr, "%s: syntax error in regex at offset %d\n", argv[0],
+            (int)(cpsre_parse(opts.regex) - opts.regex));
+    return 2;
+  }
+
+  // matching the simplified regex is equivalent and often faster
+  size_t size = cpsre_simplify(opts.regex, NULL, 0) + 1;
+  char *simplified = malloc(size);
+  if (simplified == NULL)
+    perror("malloc"), exit(2);
+  cpsre_simplify(opts.regex, simplified, size);
+  opts.regex = simplified;
+  if (opts.dump)
+    fprintf(stderr, "%s\n", opts.regex);
+
+  // `auto` picks the fastest engine that avoids backtracking, if any
+  bool automatic = strcmp(opts.engine, "auto") == 0;
+  if (automatic || strcmp(opts.engine, "jit") == 0)
+    if ((opts.jit = cpsre_jit(opts.regex)) == NULL)
+      perror("cpsre_jit"), exit(2);
+  if (automatic && !cpsre_jit_native(opts.jit))
+    cpsre_jit_free(opts.jit), opts.jit = NULL;
+  if (!opts.jit && (automatic || strcmp(opts.engine, "pike") == 0))
+    if ((opts.pike = cpsre_pike(opts.regex)) == NULL)
+      perror("cpsre_pike"), exit(2);
+
+  int nfiles = optind < argc ? argc - optind : 1;
+  struct file *files = calloc(nfiles, sizeof(*files));
+  if (files == NULL)
+    perror("calloc"), exit(2);
+  prefix = nfiles > 1;
+
+  int status = 1;
+  double start = now();
+  for (int i = 0; i < nfiles; i++) {
+    files[i].name = optind < argc ? argv[optind + i] : "-";
+    if (!map_file(&files[i])) {
+      perror(files[i].name), status = 2;
+      files[i].data = NULL;
+      continue;
+    }
+    add_jobs(&files[i]);
+  }
+
+  // without threads, or memory for them, this thread does all the work
+  pthread_t *threads = malloc(nthreads * sizeof(*threads));
+  long spawned = 0;
+  while (threads != NULL && spawned < nthreads &&
+         pthread_create(&threads[spawned], NULL, worker, NULL) == 0)
+    spawned++;
+  if (spawned == 0)
+    worker(NULL);
+
+  // print results in order as they become available
+  size_t lines = 0, bytes = 0;
+  for (size_t i = 0; i < njobs; i++) {
+    pthread_mutex_lock(&mutex);
+    while (!jobs[i].done)
+      pthread_cond_wait(&cond, &mutex);
+    pthread_mutex_unlock(&mutex);
+
+    if (jobs[i].oom)
+      fprintf(stderr, "%s: out of memory\n", argv[0]), exit(2);
+    fwrite(jobs[i].out, 1, jobs[i].out_len, stdout);
+    free(jobs[i].out);
+    jobs[i].file->count += jobs[i].selected;
+    lines += jobs[i].lines, bytes += jobs[i].end - jobs[i].begin;
+    if (jobs[i].selected && status == 1)
+      status = 0;
+  }
+
+  for (long i = 0; i < spawned; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+  double elapsed = now() - start;
+
+  for (int i = 0; i < nfiles; i++) {
+    if (opts.count && files[i].data != NULL)
+      prefix ? printf("%s:%zu\n", files[i].name, files[i].count)
+             : printf("%zu\n", files[i].count);
+    if (files[i].data != NULL && strcmp(files[i].name, "-") != 0)
+      munmap(files[i].data, files[i].map_size);
+    else
+      free(files[i].data);
+  }
+
+  if (opts.summary)
+    fprintf(stderr,
+            "%zu bytes, %zu lines in %.3f s: %.1f MB/s, %.0f lines/s "
+            "(%s engine, %ld threads)\n",
+            bytes, lines, elapsed, bytes / elapsed / 1e6, lines / elapsed,
+            opts.jit                                  ? "jit"
+            : opts.pike && cpsre_pike_linear(opts.pike) ? "pike"
+                                                      : "cps",
+            spawned ? spawned : 1);
+
+  if (opts.jit)
+    cpsre_jit_free(opts.jit);
+  if (opts.pike)
+    cpsre_pike_free(opts.pike);
+  free(simplified);
+  return status;
+}
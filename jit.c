@@ -0,0 +1,314 @@
+#define _DEFAULT_SOURCE // for `MAP_ANONYMOUS`
+#include "cps-re.h"
+#include "parse.h"
+#include <stdarg.h>
+#include <stdlib.h>
+
+// a just-in-time compiler from regular expressions to x86-64 machine code. the
+// generated code is a classic backtracking matcher: choice points are pairs of
+// an input position and a code address pushed onto the machine stack, and to
+// backtrack is to pop the most recent choice point and jump to it. this visits
+// alternatives in exactly the order the interpreter does, so results are
+// identical. for simplicity we only compile regexes without `!` or `&`, whose
+// possessive quantifiers apply to single characters and whose repeated atoms
+// can't match the empty word (the interpreter's `require_progress` then never
+// kicks in). other regexes, and other platforms, use the interpreter instead
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define JIT
+#endif
+
+struct cpsre_jit {
+  char *regex;
+  char *(*fn)(char *input, char *target); // null to use the interpreter
+  void *code;
+  size_t size;
+};
+
+#ifdef JIT
+
+// the generated function has signature `char *(char *input, char *target)`.
+// `rdi` holds the current input position throughout, `rsi` holds `target` and
+// `r11` holds the stack pointer on entry, so we can return from anywhere
+
+struct as {
+  unsigned char *code;
+  size_t len;
+  size_t *labels; // code offset of every label, once bound
+  int nlabels;
+  struct fixup {
+    size_t at; // offset of a `rel32` to patch
+    int label;
+  } *fixups;
+  int nfixups;
+  int fail; // label that backtracks
+};
+
+static void emit(struct as *as, int n, ...) {
+  // emit `n` bytes of machine code, passed as `int`s
+  va_list ap;
+  va_start(ap, n);
+  while (n--)
+    as->code[as->len++] = va_arg(ap, int);
+  va_end(ap);
+}
+
+static int label(struct as *as) { return as->nlabels++; }
+
+static void bind(struct as *as, int label) { as->labels[label] = as->len; }
+
+static void rel32(struct as *as, int label) {
+  // emit a placeholder `rel32` relative to the end of the instruction, which
+  // for all instructions we use is right after the `rel32` itself
+  as->fixups[as->nfixups++] = (struct fixup){as->len, label};
+  emit(as, 4, 0, 0, 0, 0);
+}
+
+static void jmp(struct as *as, int label) {
+  emit(as, 1, 0xe9), rel32(as, label);
+}
+
+static void jcc(struct as *as, int cc, int label) {
+  emit(as, 2, 0x0f, 0x80 | cc), rel32(as, label);
+}
+
+enum { JE = 0x4, JNE = 0x5, JBE = 0x6, JA = 0x7 };
+
+static void choice(struct as *as, int label) {
+  // push a choice point that resumes at `label` with the current input position
+  emit(as, 1, 0x57);                               // push rdi
+  emit(as, 3, 0x48, 0x8d, 0x05), rel32(as, label); // lea rax, [rip + label]
+  emit(as, 1, 0x50);                               // push rax
+}
+
+static void match_class(struct as *as, char *atom, int fail) {
+  // consume one character matched by the class `atom`, or jump to `fail`
+  char lower, upper;
+  bool compl;
+  parse_class(atom, &lower, &upper, &compl);
+  emit(as, 3, 0x0f, 0xb6, 0x07); // movzx eax, byte [rdi]
+  emit(as, 2, 0x84, 0xc0);       // test al, al
+  jcc(as, JE, fail);
+  // `lower <= c && c <= upper` if and only if `(unsigned char)(c - lower) <=
+  // (unsigned char)(upper - lower)`, whether `char` is signed or not
+  if (lower != CHAR_MIN || upper != CHAR_MAX || compl) {
+    emit(as, 2, 0x2c, (unsigned char)lower);           // sub al, lower
+    emit(as, 2, 0x3c, (unsigned char)(upper - lower)); // cmp al, upper - lower
+    jcc(as, compl ? JBE : JA, fail);
+  }
+  emit(as, 3, 0x48, 0xff, 0xc7); // inc rdi
+}
+
+static bool compile_regex(struct as *as, char *regex);
+static bool compile_atom(struct as *as, char *atom) {
+  if (*atom == '%') {
+    // `%` is `.*?`
+    int loop = label(as), more = label(as), done = label(as);
+    bind(as, loop), choice(as, more), jmp(as, done);
+    bind(as, more), match_class(as, ".", as->fail), jmp(as, loop);
+    bind(as, done);
+    return true;
+  }
+
+  if (*atom == '(')
+    return compile_regex(as, atom + 1);
+
+  match_class(as, atom, as->fail);
+  return true;
+}
+
+static bool compile_factor(struct as *as, char *factor) {
+  char *quant = parse_atom(factor);
+  bool poss = *quant && strchr("*+?", *quant) && quant[1] == '+';
+  bool lazy = *quant && strchr("*+?", *quant) && quant[1] == '?';
+  int loop = label(as), more = label(as), done = label(as);
+
+  if (poss && !is_class(factor))
+    return false;
+  if ((*quant == '*' || *quant == '+') && nullable_atom(factor))
+    return false;
+
+  switch (*quant) {
+  case '*':
+    if (poss) {
+      bind(as, loop), match_class(as, factor, done), jmp(as, loop);
+    } else if (lazy) {
+      bind(as, loop), choice(as, more), jmp(as, done), bind(as, more);
+      if (!compile_atom(as, factor))
+        return false;
+      jmp(as, loop);
+    } else {
+      bind(as, loop), choice(as, done);
+      if (!compile_atom(as, factor))
+        return false;
+      jmp(as, loop);
+    }
+    break;
+  case '+':
+    if (poss) {
+      match_class(as, factor, as->fail);
+      bind(as, loop), match_class(as, factor, done), jmp(as, loop);
+      break;
+    }
+    bind(as, loop);
+    if (!compile_atom(as, factor))
+      return false;
+    if (lazy)
+      choice(as, loop);
+    else
+      choice(as, done), jmp(as, loop);
+    break;
+  case '?':
+    if (poss)
+      match_class(as, factor, done);
+    else if (lazy) {
+      choice(as, more), jmp(as, done), bind(as, more);
+      if (!compile_atom(as, factor))
+        return false;
+    } else {
+      choice(as, done);
+      if (!compile_atom(as, factor))
+        return false;
+    }
+    break;
+  default:
+    if (!compile_atom(as, factor))
+      return false;
+    break;
+  }
+
+  bind(as, done);
+  return true;
+}
+
+static bool compile_regex(struct as *as, char *regex) {
+  // alternation is right-associative
+  int done = label(as);
+  while (1) {
+    if (*regex == '!')
+      return false;
+    char *term = regex, *factor;
+    int next = label(as);
+    char *binop = parse_term(regex);
+    if (*binop == '&')
+      return false;
+    if (*binop == '|')
+      choice(as, next);
+    for (; (factor = parse_factor(term)) != NULL; term = factor)
+      if (!compile_factor(as, term))
+        return false;
+    if (*binop != '|')
+      break;
+    jmp(as, done), bind(as, next);
+    regex = binop + 1;
+  }
+  bind(as, done);
+  return true;
+}
+
+static bool compile(struct cpsre_jit *jit, char *regex) {
+  // upper bounds on what a single character of a regex can compile to
+  size_t len = strlen(regex) + 1;
+  struct as as = {.code = malloc(len * 128),
+                  .labels = malloc(len * 16 * sizeof(size_t)),
+                  .fixups = malloc(len * 16 * sizeof(struct fixup))};
+  bool ok = as.code != NULL && as.labels != NULL && as.fixups != NULL;
+
+  int fail = as.fail = ok ? label(&as) : 0, fail_all = ok ? label(&as) : 0;
+  if (ok) {
+    emit(&as, 3, 0x49, 0x89, 0xe3); // mov r11, rsp
+    choice(&as, fail_all);          // a choice point that can't be undone
+    ok = compile_regex(&as, regex);
+  }
+
+  if (ok) {
+    // found a match. check it ends at `target` if there's one
+    int found = label(&as);
+    emit(&as, 3, 0x48, 0x85, 0xf6); // test rsi, rsi
+    jcc(&as, JE, found);
+    emit(&as, 3, 0x48, 0x39, 0xf7); // cmp rdi, rsi
+    jcc(&as, JNE, fail);
+    bind(&as, found);
+    emit(&as, 3, 0x48, 0x89, 0xf8); // mov rax, rdi
+    emit(&as, 3, 0x4c, 0x89, 0xdc); // mov rsp, r11
+    emit(&as, 1, 0xc3);             // ret
+
+    bind(&as, fail);
+    emit(&as, 1, 0x58);       // pop rax
+    emit(&as, 1, 0x5f);       // pop rdi
+    emit(&as, 2, 0xff, 0xe0); // jmp rax
+
+    bind(&as, fail_all); // the stack is back to how it was on entry
+    emit(&as, 2, 0x31, 0xc0); // xor eax, eax
+    emit(&as, 1, 0xc3);       // ret
+
+    for (int i = 0; i < as.nfixups; i++) {
+      size_t at = as.fixups[i].at;
+      long rel = (long)as.labels[as.fixups[i].label] - (long)(at + 4);
+      for (int byte = 0; byte < 4; byte++)
+        as.code[at + byte] = (unsigned long)rel >> byte * 8;
+    }
+
+    void *code = mmap(NULL, as.len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code != MAP_FAILED) {
+      memcpy(code, as.code, as.len);
+      if (mprotect(code, as.len, PROT_READ | PROT_EXEC) == 0) {
+        // ISO C doesn't let us cast an object pointer to a function pointer
+        jit->code = code, jit->size = as.len;
+        memcpy(&jit->fn, &code, sizeof(code));
+      } else
+        munmap(code, as.len);
+    }
+  }
+
+  free(as.code), free(as.labels), free(as.fixups);
+  return jit->fn != NULL;
+}
+
+#endif
+
+struct cpsre_jit *cpsre_jit(char *regex) {
+  struct cpsre_jit *jit = malloc(sizeof(*jit));
+  if (jit == NULL)
+    return NULL;
+  *jit = (struct cpsre_jit){.regex = regex};
+#ifdef JIT
+  // compiling the simplified regex avoids needless backtracking
+  size_t size = cpsre_simplify(regex, NULL, 0) + 1;
+  char *simplified = malloc(size);
+  if (simplified != NULL && *cpsre_parse(regex) == '\0')
+    cpsre_simplify(regex, simplified, size), compile(jit, simplified);
+  free(simplified);
+#endif
+  return jit;
+}
+
+bool cpsre_jit_native(struct cpsre_jit *jit) { return jit->fn != NULL; }
+
+char *cpsre_jit_anchored(struct cpsre_jit *jit, char *input, char *target) {
+  if (jit->fn == NULL)
+    return cpsre_anchored(jit->regex, input, target);
+  return jit->fn(input, target);
+}
+
+char *cpsre_jit_unanchored(struct cpsre_jit *jit, char *input, char *target) {
+  if (jit->fn == NULL)
+    return cpsre_unanchored(jit->regex, input, target);
+
+  do {
+    if (jit->fn(input, target) != NULL)
+      return input;
+  } while (*input++);
+
+  return NULL;
+}
+
+void cpsre_jit_free(struct cpsre_jit *jit) {
+#ifdef JIT
+  if (jit->code != NULL)
+    munmap(jit->code, jit->size);
+#endif
+  free(jit);
+}
@@ -0,0 +1,128 @@
+#include "cps-re.h"
+#include "parse.h"
+#include <stdlib.h>
+
+// matching every line of a buffer. lines are found with `memchr`, which libcs
+// implement with vector instructions, and each line is matched in place by
+// null-terminating it for the duration of the match. most lines don't match
+// in practice, so before matching a line we check it contains a character that
+// can begin a match at all, which for regexes like `ERROR%` is a `memchr` too
+
+static bool first_regex(char *regex, unsigned char *set);
+static bool first_term(char *term, unsigned char *set) {
+  // add to `set` the characters that can begin a match of `term`, and return
+  // whether `term` can match the empty word, or we can't tell
+  if (*term == '!')
+    return true;
+
+  for (char *next; (next = parse_factor(term)) != NULL; term = next) {
+    bool nullable = true;
+    if (*term == '%')
+      return true;
+    if (*term == '(')
+      nullable = first_regex(term + 1, set);
+    else {
+      char lower, upper;
+      bool compl;
+      parse_class(term, &lower, &upper, &compl);
+      for (int chr = CHAR_MIN; chr <= CHAR_MAX; chr++)
+        if (chr && (lower <= chr && chr <= upper) ^ compl)
+          set[(unsigned char)chr / 8] |= 1 << (unsigned char)chr % 8;
+      nullable = false;
+    }
+    char *quant = parse_atom(term);
+    if (!nullable && *quant != '*' && *quant != '?')
+      return false;
+  }
+
+  return true;
+}
+
+static bool first_regex(char *regex, unsigned char *set) {
+  // like `first_term`. in `a&b`, a match of `a&b` is a match of `a`, so `a` is
+  // all we need to look at
+  while (1) {
+    char *binop = parse_term(regex);
+    if (first_term(regex, set))
+      return true;
+    if (*binop != '|')
+      return false;
+    regex = binop + 1;
+  }
+}
+
+struct lines {
+  struct cpsre_jit *jit;
+  struct cpsre_pike *pike;
+  char *regex;
+  bool prefilter; // whether to skip lines that contain no `first` char, as
+                  // every match begins with one
+  unsigned char first[32]; // as a bitset
+  int single; // the only `first` char, or negative if there isn't just one
+};
+
+static bool may_match(struct lines *lines, char *line, char *end) {
+  if (!lines->prefilter)
+    return true;
+  if (lines->single >= 0)
+    return memchr(line, lines->single, end - line) != NULL;
+  for (; line < end; line++)
+    if (lines->first[(unsigned char)*line / 8] >> (unsigned char)*line % 8 & 1)
+      return true;
+  return false;
+}
+
+static bool match(struct lines *lines, char *line) {
+  // `line` is null-terminated. prefer engines that don't backtrack
+  if (lines->jit && cpsre_jit_native(lines->jit))
+    return cpsre_jit_unanchored(lines->jit, line, NULL) != NULL;
+  if (lines->pike)
+    return cpsre_pike_unanchored(lines->pike, line, NULL) != NULL;
+  return cpsre_unanchored(lines->regex, line, NULL) != NULL;
+}
+
+size_t cpsre_match_lines(char *regex, char *buf, size_t len,
+                         unsigned char *bitmap) {
+  // the last line may have no line ending for us to overwrite, in which case
+  // we match a copy of it instead
+  char *last = buf + len, *copy = NULL;
+  while (last > buf && last[-1] != '\n')
+    last--;
+  if (last < buf + len) {
+    if ((copy = malloc(buf + len - last + 1)) == NULL)
+      return -1;
+    memcpy(copy, last, buf + len - last), copy[buf + len - last] = '\0';
+  }
+
+  struct lines lines = {.regex = regex, .single = -1};
+  lines.prefilter =
+      *cpsre_parse(regex) == '\0' && !first_regex(regex, lines.first);
+  if ((lines.jit = cpsre_jit(regex)) != NULL && !cpsre_jit_native(lines.jit))
+    lines.pike = cpsre_pike(regex);
+  for (int chr = 0, count = 0; chr < 256; chr++)
+    if (lines.first[chr / 8] >> chr % 8 & 1)
+      lines.single = count++ ? -2 : chr;
+
+  size_t nlines = 0;
+  for (char *line = buf, *end; line < buf + len; line = end + 1, nlines++) {
+    end = line < last ? memchr(line, '\n', last - line) : buf + len;
+    if (nlines % 8 == 0)
+      bitmap[nlines / 8] = 0;
+    if (!may_match(&lines, line, end))
+      continue;
+
+    bool matched;
+    if (line == last)
+      matched = match(&lines, copy);
+    else
+      *end = '\0', matched = match(&lines, line), *end = '\n';
+    bitmap[nlines / 8] |= matched << nlines % 8;
+  }
+
+  if (lines.jit)
+    cpsre_jit_free(lines.jit);
+  if (lines.pike)
+    cpsre_pike_free(lines.pike);
+  free(copy);
+  return nlines;
+}
@@ -0,0 +1,95 @@
+#include "cps-re.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// parallel unanchored search. candidate match beginnings are handed out to
+// worker threads left to right in chunks, and every worker runs unanchored
+// searches over a few beginnings of its chunk at a time, which unlike an
+// anchored match per beginning keeps what the backtracker caches about the
+// regex. the leftmost match found so far is shared between workers so that
+// chunks to its right are never started and chunks already in progress to its
+// right are abandoned early
+
+#define MAX_CHUNK 4096 // candidate beginnings handed out at a time, at most
+#define POLL 64        // candidate beginnings tried between checks of `found`
+
+struct search {
+  char *regex, *input, *target;
+  size_t len, chunk;
+  pthread_mutex_t mutex;
+  size_t next;  // beginning of the next chunk to hand out
+  size_t found; // leftmost match beginning found so far, or `len`
+};
+
+static size_t load_found(struct search *s) {
+  pthread_mutex_lock(&s->mutex);
+  size_t found = s->found;
+  pthread_mutex_unlock(&s->mutex);
+  return found;
+}
+
+static void *worker(void *arg) {
+  struct search *s = arg;
+
+  while (1) {
+    pthread_mutex_lock(&s->mutex);
+    size_t begin = s->next, end = begin + s->chunk;
+    s->next = end;
+    size_t found = s->found;
+    pthread_mutex_unlock(&s->mutex);
+
+    // a match to our left was found, so everything we'd try is irrelevant
+    if (begin >= found)
+      return NULL;
+    if (end > found)
+      end = found;
+
+    for (size_t i = begin, limit; i < end; i = limit) {
+      if (i != begin && i >= load_found(s))
+        return NULL;
+      limit = end - i > POLL ? i + POLL : end;
+      char *match = cpsre_unanchored_until(s->regex, s->input + i,
+                                           s->input + limit, s->target);
+      if (match != NULL) {
+        pthread_mutex_lock(&s->mutex);
+        if ((size_t)(match - s->input) < s->found)
+          s->found = match - s->input;
+        pthread_mutex_unlock(&s->mutex);
+        return NULL; // anything else we'd find would be to the right
+      }
+    }
+  }
+}
+
+char *cpsre_unanchored_parallel(char *regex, char *input, char *target,
+                                int nthreads) {
+  if (nthreads <= 1)
+    return cpsre_unanchored(regex, input, target);
+
+  // `cpsre_unanchored` also tries the position of the null terminator, so
+  // there are `len` candidate beginnings, the terminator included
+  size_t len = strlen(input) + 1;
+  size_t chunk = len / ((size_t)nthreads * 16);
+  chunk = chunk < 1 ? 1 : chunk > MAX_CHUNK ? MAX_CHUNK : chunk;
+
+  struct search s = {.regex = regex, .input = input, .target = target,
+                     .len = len, .chunk = chunk, .next = 0, .found = len};
+  pthread_mutex_init(&s.mutex, NULL);
+
+  // the calling thread is a worker too. if we fail to spawn a thread, or to
+  // allocate memory for them, the remaining workers simply pick up its share
+  // of the chunks
+  pthread_t *threads = malloc((nthreads - 1) * sizeof(*threads));
+  int spawned = 0;
+  while (threads != NULL && spawned < nthreads - 1 &&
+         pthread_create(&threads[spawned], NULL, worker, &s) == 0)
+    spawned++;
+  worker(&s);
+  for (int i = 0; i < spawned; i++)
+    pthread_join(threads[i], NULL);
+  free(threads);
+
+  pthread_mutex_destroy(&s.mutex);
+  return s.found < len ? input + s.found : NULL;
+}
@@ -0,0 +1,141 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+
+// the parser of `cps-re.c`, for the tools and alternative engines that need to
+// walk regular expressions themselves. every `parse_...` function returns a
+// pointer one past the end of what it parsed, or `NULL` on a syntax error.
+// functions are `inline` so files that only use some of them don't get warned
+
+#define METACHARS "\\-.~%*+?|&!()"
+
+// keep in sync with cps-re.c
+
+static inline char *parse_symbol(char *regex, char *sym) {
+  if (!strchr(METACHARS, *regex))
+    return *sym = *regex, ++regex;
+  if (*regex == '\\' && *++regex && strchr(METACHARS, *regex))
+    return *sym = *regex, ++regex;
+  return NULL; // syntax
+}
+
+static inline char *parse_regex(char *regex);
+static inline char *parse_atom(char *regex) {
+  if (*regex == '%')
+    return ++regex;
+  if (*regex == '(') {
+    if (*(regex = parse_regex(++regex)) == ')')
+      return ++regex;
+    return NULL; // syntax
+  }
+  *regex == '~' && regex++;
+  if (*regex == '.')
+    return ++regex;
+  regex = parse_symbol(regex, &(char){0});
+  if (regex != NULL && *regex == '-')
+    return parse_symbol(++regex, &(char){0}); // syntax or ok
+  return regex;                               // syntax or ok
+}
+
+static inline char *parse_factor(char *regex) {
+  if ((regex = parse_atom(regex)) == NULL)
+    return NULL; // syntax
+  if (*regex && strchr("*+?", *regex))
+    if (*++regex && strchr("+?", *regex))
+      regex++;
+  return regex;
+}
+
+static inline char *parse_term(char *regex) {
+  if (*regex == '!')
+    regex++;
+  for (char *term; (term = parse_factor(regex)) != NULL;)
+    regex = term;
+  return regex;
+}
+
+static inline char *parse_regex(char *regex) {
+  while (regex = parse_term(regex), *regex == '|' || *regex == '&')
+    regex++;
+  return regex;
+}
+
+// for an atom other than `%` and `(...)`, find the characters it matches. a
+// character `c` other than the null terminator matches if and only if `(*lower
+// <= c && c <= *upper) ^ *compl`, where `*lower <= *upper`. the null
+// terminator never matches
+static inline char *parse_class(char *atom, char *lower, char *upper, bool *compl) {
+  char temp;
+  *lower = *upper = '\0';
+  *compl = *atom == '~' && atom++;
+
+  if (*atom == '.')
+    return *lower = CHAR_MIN, *upper = CHAR_MAX, ++atom;
+
+  atom = parse_symbol(atom, lower), *upper = *lower;
+  if (atom != NULL && *atom == '-')
+    atom = parse_symbol(++atom, upper);
+  if (atom == NULL)
+    return NULL; // syntax
+
+  // character range wraparound. a range that wraps around everything but
+  // itself, such as `b-a`, is normalized so that `*lower <= *upper` holds
+  if (*lower > *upper)
+    temp = *upper, *upper = *lower - 1, *lower = temp + 1, *compl = !*compl;
+  if (*lower > *upper)
+    *lower = CHAR_MIN, *upper = CHAR_MAX, *compl = !*compl;
+  return atom;
+}
+
+static inline bool nullable(char *regex);
+static inline bool nullable_atom(char *atom) {
+  if (*atom == '%')
+    return true;
+  if (*atom == '(')
+    return nullable(atom + 1);
+  return false;
+}
+
+static inline bool nullable(char *regex) {
+  // whether `regex` matches the empty word. `!` and `&` are not supported
+  while (1) {
+    char *term = regex, *factor;
+    bool term_nullable = true;
+    for (; (factor = parse_factor(term)) != NULL; term = factor) {
+      char *quant = parse_atom(term);
+      if (*quant != '*' && *quant != '?' && !nullable_atom(term))
+        term_nullable = false;
+    }
+    if (term_nullable)
+      return true;
+    if (*term != '|')
+      return false;
+    regex = term + 1;
+  }
+}
+
+static inline bool is_class(char *atom) { return *atom != '%' && *atom != '('; }
+
+static inline bool excludes(char *term, char *atom) {
+  // whether every match of `term` begins with a character the character class
+  // `atom` doesn't match, in which case a greedy quantifier over `atom` followed
+  // by `term` is as good as possessive. gives up on `%` and `(...)`
+  char lower, upper, term_lower, term_upper;
+  bool compl, term_compl;
+  parse_class(atom, &lower, &upper, &compl);
+
+  for (char *next; (next = parse_factor(term)) != NULL; term = next) {
+    if (!is_class(term))
+      return false;
+    parse_class(term, &term_lower, &term_upper, &term_compl);
+    for (int chr = CHAR_MIN; chr <= CHAR_MAX; chr++)
+      if (chr && (lower <= chr && chr <= upper) ^ compl &&
+          (term_lower <= chr && chr <= term_upper) ^ term_compl)
+        return false;
+    char *quant = parse_atom(term);
+    if (*quant != '*' && *quant != '?')
+      return true;
+  }
+
+  return false; // `term` matches the empty word
+}
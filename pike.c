@@ -0,0 +1,856 @@
+#include "cps-re.h"
+#include "parse.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// a pike vm. regular expressions are compiled to a program for a thompson nfa,
+// and all threads of that nfa are simulated in lockstep, one character of input
+// at a time. threads are kept in priority order, that is, in the order the
+// backtracker would explore them, and whenever two threads reach the same
+// instruction at the same position the lower-priority one is dropped, as it
+// couldn't possibly do anything the higher-priority one can't. this reproduces
+// the backtracker's leftmost-first results in time linear in the input.
+// regexes with `!`, `&` or possessive quantifiers other than those
+// `cpsre_simplify` introduces, and regexes that repeat atoms which can match
+// the empty word, are left to the backtracker
+
+struct inst {
+  enum { CLASS, SPLIT, JMP, MATCH } op;
+  char lower, upper; // for `CLASS`, see `parse_class`
+  bool compl ;
+  int x, y; // for `SPLIT`, prefer `x` over `y`. for `JMP`, go to `x`
+};
+
+struct cpsre_pike {
+  char *regex;
+  int len;           // number of instructions, or 0 to use the backtracker
+  struct inst *prog; // `CLASS` instructions continue with the next one
+  bool nullable;     // whether the program matches the empty word
+  unsigned char first[32]; // characters that can begin a match, as a bitset
+  bool loaded;             // whether `regex` and `prog` belong to a buffer
+  struct bits *bits;       // or null if the regex is too big for one
+  bool loose; // compile any regex, to a superset of its matches, see the lexer
+};
+
+struct thread {
+  int pc;
+  char *begin; // where the match this thread is working on began
+};
+
+struct list {
+  struct thread *threads;
+  int len;
+};
+
+#define SMALL_VM 1024 // threads worth of vm buffers that go on the stack
+
+static int emit(struct cpsre_pike *pike, struct inst inst) {
+  pike->prog[pike->len] = inst;
+  return pike->len++;
+}
+
+static bool compile_regex(struct cpsre_pike *pike, char *regex);
+static bool compile_atom(struct cpsre_pike *pike, char *atom) {
+  if (*atom == '%') {
+    // `%` is `.*?`
+    int split = emit(pike, (struct inst){.op = SPLIT});
+    emit(pike, (struct inst){.op = CLASS, .lower = CHAR_MIN, .upper = CHAR_MAX});
+    emit(pike, (struct inst){.op = JMP, .x = split});
+    pike->prog[split].x = pike->len, pike->prog[split].y = split + 1;
+    return true;
+  }
+
+  if (*atom == '(')
+    return compile_regex(pike, atom + 1);
+
+  struct inst inst = {.op = CLASS};
+  parse_class(atom, &inst.lower, &inst.upper, &inst.compl);
+  emit(pike, inst);
+  return true;
+}
+
+static bool compile_factor(struct cpsre_pike *pike, char *factor) {
+  char *quant = parse_atom(factor);
+  bool poss = *quant && strchr("*+?", *quant) && quant[1] == '+';
+  bool lazy = *quant && strchr("*+?", *quant) && quant[1] == '?';
+  int begin = pike->len, split;
+
+  // possessive quantifiers are only supported where they're as good as greedy
+  if (poss && !pike->loose &&
+      !(is_class(factor) && excludes(parse_factor(factor), factor)))
+    return false;
+  if ((*quant == '*' || *quant == '+') && nullable_atom(factor) && !pike->loose)
+    return false;
+
+  switch (*quant) {
+  case '*':
+    split = emit(pike, (struct inst){.op = SPLIT});
+    if (!compile_atom(pike, factor))
+      return false;
+    emit(pike, (struct inst){.op = JMP, .x = split});
+    pike->prog[split].x = lazy ? pike->len : split + 1;
+    pike->prog[split].y = lazy ? split + 1 : pike->len;
+    return true;
+  case '+':
+    if (!compile_atom(pike, factor))
+      return false;
+    split = emit(pike, (struct inst){.op = SPLIT});
+    pike->prog[split].x = lazy ? pike->len : begin;
+    pike->prog[split].y = lazy ? begin : pike->len;
+    return true;
+  case '?':
+    split = emit(pike, (struct inst){.op = SPLIT});
+    if (!compile_atom(pike, factor))
+      return false;
+    pike->prog[split].x = lazy ? pike->len : split + 1;
+    pike->prog[split].y = lazy ? split + 1 : pike->len;
+    return true;
+  default:
+    return compile_atom(pike, factor);
+  }
+}
+
+static bool compile_regex(struct cpsre_pike *pike, char *regex) {
+  // alternation is right-associative, but is compiled in a loop rather than
+  // recursively, as regexes can have many alternatives. the `JMP`s past the
+  // alternatives are chained through `x` until we know where they go
+  int jmps = -1;
+  while (1) {
+    char *binop = parse_term(regex), *factor;
+    if ((*regex == '!' || *binop == '&') && !pike->loose)
+      return false;
+
+    // loosely, `!` matches anything and `&` only its left-hand side
+    int split = *binop == '|' ? emit(pike, (struct inst){.op = SPLIT}) : -1;
+    if (*regex == '!')
+      compile_atom(pike, "%");
+    else
+      for (; (factor = parse_factor(regex)) != NULL; regex = factor)
+        if (!compile_factor(pike, regex))
+          return false;
+    if (split < 0)
+      break;
+
+    jmps = emit(pike, (struct inst){.op = JMP, .x = jmps});
+    pike->prog[split].x = split + 1, pike->prog[split].y = pike->len;
+    regex = binop + 1;
+  }
+
+  for (int jmp = jmps, next; jmp >= 0; jmp = next)
+    next = pike->prog[jmp].x, pike->prog[jmp].x = pike->len;
+  return true;
+}
+
+static void add_thread(struct cpsre_pike *pike, struct list *list, int *seen,
+                       int *stack, int step, struct thread thread);
+
+static size_t vm_size(int len) {
+  // the threads, `seen` and stack of a vm for a program of `len` instructions
+  // go in one buffer of this size, see `start`. they're too big for the stack
+  // with large regexes
+  return len * 2 * sizeof(struct thread) + (len * 3 + 1) * sizeof(int);
+}
+
+static void analyze(struct cpsre_pike *pike) {
+  // find what a match can begin with, so unanchored searches can skip input
+  // that can't begin a match. without memory, any character can
+  struct thread *threads = malloc(vm_size(pike->len));
+  if (threads == NULL) {
+    pike->nullable = true, memset(pike->first, 0xff, sizeof(pike->first));
+    return;
+  }
+  int *seen = (int *)(threads + pike->len * 2), *stack = seen + pike->len;
+  struct list list = {threads, 0};
+  for (int pc = 0; pc < pike->len; pc++)
+    seen[pc] = -1;
+  add_thread(pike, &list, seen, stack, 0, (struct thread){0, NULL});
+
+  for (int i = 0; i < list.len; i++) {
+    struct inst *inst = &pike->prog[list.threads[i].pc];
+    if (inst->op == MATCH)
+      pike->nullable = true;
+    else
+      for (int chr = CHAR_MIN; chr <= CHAR_MAX; chr++)
+        if ((inst->lower <= chr && chr <= inst->upper) ^ inst->compl)
+          pike->first[(unsigned char)chr / 8] |= 1 << (unsigned char)chr % 8;
+  }
+  free(threads);
+}
+
+// a bit-parallel engine. in the glushkov automaton of a regex, states are the
+// character classes of the regex, or positions, and a state is entered by
+// matching its class. with at most 64 positions, a set of states is a 64-bit
+// word, and a step of the automaton is a few table lookups: for every byte of
+// the word, the positions that can follow those in it, and for every input
+// character, the positions whose class contains it. this decides whether a
+// match exists, and exactly which matches end at a given `target`, but not
+// where the backtracker's leftmost-first match ends, which is left to the pike
+// vm. regexes with `!` or `&` have no glushkov automaton, and possessive
+// quantifiers are only supported where they're as good as greedy
+
+#define NPOS 64
+
+struct glushkov {
+  uint64_t first, last; // positions a match can begin and end with
+  bool nullable;
+};
+
+struct builder {
+  int len;
+  uint64_t follow[NPOS], chars[256];
+};
+
+struct bits {
+  uint64_t first, last, chars[256]; // `chars[c]` is positions that accept `c`
+  bool nullable;
+  int nbytes; // of the state that are used, one table for each below
+  uint64_t (*follow)[256], (*precede)[256];
+  uint64_t tables[][256];
+};
+
+static void add_follow(struct builder *builder, uint64_t from, uint64_t to) {
+  for (int pos = 0; pos < builder->len; pos++)
+    if (from >> pos & 1)
+      builder->follow[pos] |= to;
+}
+
+static bool glushkov_regex(struct builder *builder, char *regex,
+                           struct glushkov *g);
+static bool glushkov_atom(struct builder *builder, char *atom,
+                          struct glushkov *g) {
+  if (*atom == '(')
+    return glushkov_regex(builder, atom + 1, g);
+  if (builder->len == NPOS)
+    return false;
+
+  int pos = builder->len++;
+  uint64_t bit = (uint64_t)1 << pos;
+  char lower = CHAR_MIN, upper = CHAR_MAX;
+  bool compl = false;
+  if (*atom != '%')
+    parse_class(atom, &lower, &upper, &compl);
+  for (int chr = CHAR_MIN; chr <= CHAR_MAX; chr++)
+    if (chr && (lower <= chr && chr <= upper) ^ compl)
+      builder->chars[(unsigned char)chr] |= bit;
+
+  // `%` is `.*?`
+  *g = (struct glushkov){.first = bit, .last = bit, .nullable = *atom == '%'};
+  if (*atom == '%')
+    builder->follow[pos] |= bit;
+  return true;
+}
+
+static bool glushkov_factor(struct builder *builder, char *factor,
+                            struct glushkov *g) {
+  char *quant = parse_atom(factor);
+  bool poss = *quant && strchr("*+?", *quant) && quant[1] == '+';
+  if (poss && !(is_class(factor) && excludes(parse_factor(factor), factor)))
+    return false;
+  if (!glushkov_atom(builder, factor, g))
+    return false;
+  if (*quant == '*' || *quant == '+')
+    add_follow(builder, g->last, g->first);
+  if (*quant == '*' || *quant == '?')
+    g->nullable = true;
+  return true;
+}
+
+static bool glushkov_regex(struct builder *builder, char *regex,
+                           struct glushkov *g) {
+  // alternatives are walked in a loop, like in `compile_regex`. empty ones
+  // take no positions, so there can be any number of them
+  *g = (struct glushkov){0};
+  while (1) {
+    char *binop = parse_term(regex), *factor;
+    if (*regex == '!' || *binop == '&')
+      return false;
+
+    struct glushkov term = {.nullable = true};
+    for (; (factor = parse_factor(regex)) != NULL; regex = factor) {
+      struct glushkov next;
+      if (!glushkov_factor(builder, regex, &next))
+        return false;
+      add_follow(builder, term.last, next.first);
+      term.first |= term.nullable ? next.first : 0;
+      term.last = next.last | (next.nullable ? term.last : 0);
+      term.nullable = term.nullable && next.nullable;
+    }
+    g->first |= term.first, g->last |= term.last;
+    g->nullable = g->nullable || term.nullable;
+    if (*binop != '|')
+      return true;
+    regex = binop + 1;
+  }
+}
+
+static struct bits *compile_bits(char *regex) {
+  // returns null if `regex` isn't supported or if we run out of memory
+  struct builder builder = {0};
+  struct glushkov g;
+  if (!glushkov_regex(&builder, regex, &g))
+    return NULL;
+
+  int nbytes = (builder.len + 7) / 8;
+  struct bits *bits =
+      malloc(sizeof(*bits) + nbytes * 2 * sizeof(*bits->tables));
+  if (bits == NULL)
+    return NULL;
+  *bits = (struct bits){.first = g.first,
+                        .last = g.last,
+                        .nullable = g.nullable,
+                        .nbytes = nbytes,
+                        .follow = bits->tables,
+                        .precede = bits->tables + nbytes};
+  memcpy(bits->chars, builder.chars, sizeof(bits->chars));
+
+  for (int byte = 0; byte < nbytes; byte++)
+    for (int set = 0; set < 256; set++) {
+      bits->follow[byte][set] = bits->precede[byte][set] = 0;
+      for (int i = 0; i < 8; i++)
+        if (set >> i & 1 && byte * 8 + i < builder.len)
+          bits->follow[byte][set] |= builder.follow[byte * 8 + i];
+      for (int pos = 0; pos < builder.len; pos++)
+        if (builder.follow[pos] >> byte * 8 & set)
+          bits->precede[byte][set] |= (uint64_t)1 << pos;
+    }
+  return bits;
+}
+
+static uint64_t step_bits(struct bits *bits, uint64_t (*table)[256],
+                          uint64_t state, char chr) {
+  uint64_t next = 0;
+  for (int byte = 0; byte < bits->nbytes; byte++)
+    next |= table[byte][state >> byte * 8 & 0xff];
+  return next & bits->chars[(unsigned char)chr];
+}
+
+static char *run_bits(struct bits *bits, char *input, char *target,
+                      bool anchored) {
+  // returns where the match that ends first ends, or null if there is none,
+  // with the same meaning of arguments as `run`. when not `anchored`, positions
+  // a match can begin with are entered at every step
+  uint64_t state = 0;
+  for (char *pos = input;; pos++) {
+    // with no states left, skip ahead to where a match could begin
+    if (!anchored && state == 0 && !bits->nullable)
+      while (*pos && pos != target &&
+             !(bits->first & bits->chars[(unsigned char)*pos]))
+        pos++;
+    bool start = !anchored || pos == input;
+    bool accept = state & bits->last || (start && bits->nullable);
+    if (target == NULL ? accept : pos == target)
+      return accept ? pos : NULL;
+    if (*pos == '\0' || (anchored && pos > input && state == 0))
+      return NULL;
+    state = step_bits(bits, bits->follow, state, *pos) |
+            (start ? bits->first & bits->chars[(unsigned char)*pos] : 0);
+  }
+}
+
+static char *leftmost_bits(struct bits *bits, char *input, char *target,
+                           bool anchored) {
+  // the leftmost position from which a match ends at `target`, or anywhere up
+  // to `target` if not `anchored`, found in a single pass by running the
+  // automaton backwards from `target`
+  char *begin = bits->nullable ? target : NULL;
+  uint64_t state = 0;
+  for (char *pos = target; pos > input;) {
+    pos--;
+    bool start = !anchored || pos == target - 1;
+    state = step_bits(bits, bits->precede, state, *pos) |
+            (start ? bits->last & bits->chars[(unsigned char)*pos] : 0);
+    if (anchored && state == 0)
+      break;
+    if (state & bits->first)
+      begin = pos;
+  }
+  return begin;
+}
+
+static char *search_bits(struct bits *bits, char *input) {
+  // the leftmost position from which a match begins, like `cpsre_unanchored`
+  // with a null `target`. a forward pass finds where the first match to end
+  // ends, and a backward pass from there where the leftmost match ending there
+  // begins. under leftmost-first semantics, that's only an upper bound: in
+  // `abcd|c`, the `c` of `abcd` ends a match first, but `abcd` begins further
+  // left. matches like that end further right, so what's left of the bound is
+  // checked by anchored runs from every position that can begin a match. if
+  // those take more steps than the forward pass did, a backward pass over the
+  // rest of the input settles it instead, so this is linear overall
+  char *end = run_bits(bits, input, NULL, false);
+  if (end == NULL)
+    return NULL;
+  char *begin = leftmost_bits(bits, input, end, true);
+
+  size_t budget = end - input;
+  for (char *pos = input; pos < begin; pos++) {
+    uint64_t state = bits->first & bits->chars[(unsigned char)*pos];
+    for (char *next = pos + 1; state; next++) {
+      if (state & bits->last)
+        return pos;
+      if (budget-- == 0)
+        return leftmost_bits(bits, input, end + strlen(end), false);
+      state = step_bits(bits, bits->follow, state, *next);
+    }
+  }
+  return begin;
+}
+
+struct cpsre_pike *cpsre_pike(char *regex) {
+  // every character of a regex compiles to at most three instructions
+  struct cpsre_pike *pike = malloc(sizeof(*pike));
+  if (pike == NULL)
+    return NULL;
+  // ill-formed regexes match nothing, like `~.`
+  if (*cpsre_parse(regex) != '\0')
+    regex = "~.";
+  *pike = (struct cpsre_pike){.regex = regex};
+  pike->bits = compile_bits(regex);
+  if ((pike->prog = malloc((strlen(regex) * 3 + 1) * sizeof(struct inst))) ==
+      NULL)
+    return free(pike), NULL;
+
+  if (compile_regex(pike, regex))
+    emit(pike, (struct inst){.op = MATCH}), analyze(pike);
+  else
+    pike->len = 0;
+  return pike;
+}
+
+bool cpsre_pike_linear(struct cpsre_pike *pike) { return pike->len != 0; }
+
+void cpsre_pike_free(struct cpsre_pike *pike) {
+  if (!pike->loaded)
+    free(pike->prog);
+  free(pike->bits);
+  free(pike);
+}
+
+// a saved `struct cpsre_pike` is this header, followed by `len` instructions,
+// followed by the regex and its null terminator, `regex_size` bytes in total.
+// `byte_order` and `inst_size` reject buffers saved on other platforms. bump
+// `VERSION` whenever the layout of the header or of instructions changes
+#define MAGIC "cpsre\0\0"
+#define VERSION 1
+#define BYTE_ORDER_MARK 0x01020304
+
+struct saved {
+  char magic[8];
+  uint32_t version, byte_order, inst_size;
+  uint32_t checksum; // of everything after the header
+  int32_t len, regex_size;
+  unsigned char nullable, first[32];
+};
+
+static uint32_t checksum(unsigned char *bytes, size_t size) {
+  // 32-bit fnv-1a
+  uint32_t hash = 2166136261u;
+  while (size--)
+    hash = (hash ^ *bytes++) * 16777619u;
+  return hash;
+}
+
+size_t cpsre_pike_save(struct cpsre_pike *pike, void *buf, size_t size) {
+  struct saved saved = {.magic = MAGIC,
+                        .version = VERSION,
+                        .byte_order = BYTE_ORDER_MARK,
+                        .inst_size = sizeof(struct inst),
+                        .len = pike->len,
+                        .regex_size = strlen(pike->regex) + 1,
+                        .nullable = pike->nullable};
+  size_t prog_size = pike->len * sizeof(struct inst);
+  size_t needed = sizeof(saved) + prog_size + saved.regex_size;
+  if (size < needed)
+    return needed;
+
+  unsigned char *bytes = buf;
+  memcpy(saved.first, pike->first, sizeof(saved.first));
+  memcpy(bytes + sizeof(saved), pike->prog, prog_size);
+  memcpy(bytes + sizeof(saved) + prog_size, pike->regex, saved.regex_size);
+  saved.checksum = checksum(bytes + sizeof(saved), needed - sizeof(saved));
+  memcpy(bytes, &saved, sizeof(saved));
+  return needed;
+}
+
+struct cpsre_pike *cpsre_pike_load(void *buf, size_t size) {
+  // the checks below guarantee `run` stays within the program, as compiling
+  // would. the regex itself is only parsed if the backtracker is used
+  struct saved *saved = buf;
+  if ((uintptr_t)buf % sizeof(int) != 0 || size < sizeof(*saved) ||
+      memcmp(saved->magic, MAGIC, sizeof(saved->magic)) != 0 ||
+      saved->version != VERSION || saved->byte_order != BYTE_ORDER_MARK ||
+      saved->inst_size != sizeof(struct inst))
+    return NULL;
+
+  // the sizes in the header are untrusted, so they're bounded by `size` before
+  // any arithmetic is done with them
+  int len = saved->len;
+  size_t rest = size - sizeof(*saved);
+  if (len < 0 || saved->regex_size < 1 || (size_t)saved->regex_size > rest ||
+      (size_t)len > (rest - saved->regex_size) / sizeof(struct inst) ||
+      (int64_t)len > ((int64_t)saved->regex_size - 1) * 3 + 1 ||
+      rest != len * sizeof(struct inst) + saved->regex_size ||
+      checksum((unsigned char *)(saved + 1), rest) != saved->checksum)
+    return NULL;
+
+  struct inst *prog = (struct inst *)(saved + 1);
+  char *regex = (char *)(prog + len);
+  if (strlen(regex) != (size_t)saved->regex_size - 1)
+    return NULL;
+  for (int pc = 0; pc < len; pc++) {
+    struct inst *inst = &prog[pc];
+    if ((unsigned)inst->op > MATCH || *(unsigned char *)&inst->compl > 1 ||
+        (inst->op == CLASS && (pc + 1 >= len || inst->lower > inst->upper)) ||
+        (inst->op == SPLIT && (inst->y < 0 || inst->y >= len)) ||
+        ((inst->op == SPLIT || inst->op == JMP) &&
+         (inst->x < 0 || inst->x >= len)))
+      return NULL;
+  }
+
+  struct cpsre_pike *pike = malloc(sizeof(*pike));
+  if (pike == NULL)
+    return NULL;
+  *pike = (struct cpsre_pike){.regex = regex,
+                              .len = len,
+                              .prog = prog,
+                              .nullable = saved->nullable,
+                              .loaded = true};
+  memcpy(pike->first, saved->first, sizeof(pike->first));
+  return pike;
+}
+
+static void add_thread(struct cpsre_pike *pike, struct list *list, int *seen,
+                       int *stack, int step, struct thread thread) {
+  // add `thread` and everything reachable from it without consuming input to
+  // `list`, in priority order. `seen[pc] == step` means `pc` was already
+  // reached by a higher-priority thread during this step
+  int sp = 0;
+  stack[sp++] = thread.pc;
+  while (sp) {
+    int pc = stack[--sp];
+    if (seen[pc] == step)
+      continue;
+    seen[pc] = step;
+    struct inst *inst = &pike->prog[pc];
+    if (inst->op == JMP)
+      stack[sp++] = inst->x;
+    else if (inst->op == SPLIT)
+      stack[sp++] = inst->y, stack[sp++] = inst->x;
+    else
+      list->threads[list->len++] = (struct thread){pc, thread.begin};
+  }
+}
+
+// the state of a run of the program, kept out of the call stack so that a run
+// can stop after a number of steps and pick up again later. one step is one
+// position of the input
+struct vm {
+  char *input, *target;
+  bool anchored;
+  struct list clist, nlist;
+  int *seen, *stack;
+  char *pos;
+  int step;
+  char *begin, *end; // of the match found so far, if any
+};
+
+static void start(struct cpsre_pike *pike, struct vm *vm, char *input,
+                  char *target, bool anchored, void *buf) {
+  // `buf` holds `vm_size(pike->len)` bytes: `2 * pike->len` threads, then
+  // `pike->len` ints for `seen` and `2 * pike->len + 1` for the stack
+  struct thread *threads = buf;
+  int *seen = (int *)(threads + pike->len * 2), *stack = seen + pike->len;
+  *vm = (struct vm){.input = input,
+                    .target = target,
+                    .anchored = anchored,
+                    .clist = {threads, 0},
+                    .nlist = {threads + pike->len, 0},
+                    .seen = seen,
+                    .stack = stack,
+                    .pos = input};
+  for (int pc = 0; pc < pike->len; pc++)
+    seen[pc] = -1;
+}
+
+static bool resume(struct cpsre_pike *pike, struct vm *vm, size_t steps) {
+  // run the program for at most `steps` steps and return whether it's done, in
+  // which case `vm->begin` is the beginning of the match found, or null if
+  // there is none. when not `anchored`, a new thread is started at every
+  // position of the input with lower priority than all the others, until a
+  // match is found
+  char *input = vm->input, *target = vm->target, *pos = vm->pos;
+  bool anchored = vm->anchored;
+  struct list clist = vm->clist, nlist = vm->nlist;
+  int *seen = vm->seen, *stack = vm->stack, step = vm->step;
+
+  for (;; pos++, step++) {
+    if (steps-- == 0) {
+      vm->pos = pos, vm->step = step, vm->clist = clist, vm->nlist = nlist;
+      return false;
+    }
+    // with no threads left, skip ahead to where a match could begin
+    if (!anchored && clist.len == 0 && !pike->nullable)
+      while (steps && *pos && pos != target &&
+             (~pike->first[(unsigned char)*pos / 8] >> (unsigned char)*pos % 8 &
+              1))
+        pos++, steps--;
+    if (vm->begin == NULL && (!anchored || pos == input))
+      add_thread(pike, &clist, seen, stack, step, (struct thread){0, pos});
+    if (clist.len == 0)
+      break;
+
+    nlist.len = 0;
+    for (int i = 0; i < clist.len; i++) {
+      struct thread thread = clist.threads[i];
+      struct inst *inst = &pike->prog[thread.pc];
+      if (inst->op == MATCH) {
+        if (target != NULL && pos != target)
+          continue;
+        // lower-priority threads can no longer influence the result
+        vm->begin = thread.begin, vm->end = pos;
+        break;
+      }
+      if (*pos && (inst->lower <= *pos && *pos <= inst->upper) ^ inst->compl)
+        add_thread(pike, &nlist, seen, stack, step + 1,
+                   (struct thread){thread.pc + 1, thread.begin});
+    }
+
+    if (*pos == '\0' || (target != NULL && pos == target))
+      break;
+    struct list temp = clist;
+    clist = nlist, nlist = temp;
+  }
+
+  return true;
+}
+
+static char *run(struct cpsre_pike *pike, char *input, char *target,
+                 bool anchored, char **end) {
+  // run the program to completion and return the beginning of the match found,
+  // or null if there is none. most programs are small enough for buffers on
+  // the stack, which saves allocating them on every call. without memory, the
+  // backtracker finds the match instead
+  struct thread small[SMALL_VM];
+  size_t size = vm_size(pike->len);
+  void *buf = size <= sizeof(small) ? small : malloc(size);
+  if (buf == NULL) {
+    char *begin =
+        anchored ? input : cpsre_unanchored(pike->regex, input, target);
+    *end = begin == NULL ? NULL : cpsre_anchored(pike->regex, begin, target);
+    return *end == NULL ? NULL : begin;
+  }
+
+  struct vm vm;
+  start(pike, &vm, input, target, anchored, buf);
+  resume(pike, &vm, SIZE_MAX);
+  if (buf != small)
+    free(buf);
+  *end = vm.end;
+  return vm.begin;
+}
+
+char *cpsre_pike_anchored(struct cpsre_pike *pike, char *input, char *target) {
+  if (pike->bits != NULL) {
+    // with a `target`, the match ends there or doesn't exist
+    char *end = run_bits(pike->bits, input, target, true);
+    if (target != NULL || end == NULL)
+      return end;
+  }
+  if (pike->len == 0)
+    return cpsre_anchored(pike->regex, input, target);
+  char *end;
+  return run(pike, input, target, true, &end) == NULL ? NULL : end;
+}
+
+char *cpsre_pike_unanchored(struct cpsre_pike *pike, char *input,
+                            char *target) {
+  if (pike->bits != NULL && target != NULL)
+    return leftmost_bits(pike->bits, input, target, true);
+  // the vm is faster than `search_bits` at its worst, but the backtracker isn't
+  if (pike->bits != NULL && pike->len == 0)
+    return search_bits(pike->bits, input);
+  if (pike->bits != NULL && !run_bits(pike->bits, input, NULL, false))
+    return NULL;
+  if (pike->len == 0)
+    return cpsre_unanchored(pike->regex, input, target);
+  char *end;
+  return run(pike, input, target, false, &end);
+}
+
+char *cpsre_pike_find(struct cpsre_pike *pike, char *input, char **end) {
+  // the vm finds where the match ends in the same run
+  if (pike->len > 0) {
+    if (pike->bits != NULL && !run_bits(pike->bits, input, NULL, false))
+      return *end = NULL;
+    return run(pike, input, NULL, false, end);
+  }
+  char *begin = cpsre_pike_unanchored(pike, input, NULL);
+  *end = begin == NULL ? NULL : cpsre_anchored(pike->regex, begin, NULL);
+  return begin;
+}
+
+// a resumable search keeps the state of the vm in the `struct cpsre_search`
+// rather than on the stack. regexes the vm can't run aren't supported, as the
+// backtracker can't be interrupted
+
+struct cpsre_search {
+  struct cpsre_pike *pike;
+  struct vm vm;
+  int result; // or `CPSRE_PENDING` until the search is done
+};
+
+struct cpsre_search *cpsre_search(struct cpsre_pike *pike, char *input,
+                                  char *target) {
+  // the buffers of the vm follow the struct
+  struct cpsre_search *search =
+      pike->len == 0
+          ? NULL
+          : malloc(sizeof(struct cpsre_search) + vm_size(pike->len));
+  if (search == NULL)
+    return NULL;
+  *search = (struct cpsre_search){.pike = pike, .result = CPSRE_PENDING};
+  start(pike, &search->vm, input, target, false, search + 1);
+  return search;
+}
+
+int cpsre_search_run(struct cpsre_search *search, size_t steps, char **begin,
+                     char **end) {
+  struct cpsre_pike *pike = search->pike;
+  struct vm *vm = &search->vm;
+  if (search->result == CPSRE_PENDING && resume(pike, vm, steps))
+    search->result = vm->begin != NULL;
+
+  if (search->result == 1)
+    *begin = vm->begin, *end = vm->end;
+  return search->result;
+}
+
+void cpsre_search_free(struct cpsre_search *search) { free(search); }
+
+// a lexer runs the programs of all its rules at once, starting at the same
+// position. unlike above, we want the longest match rather than the first one,
+// so we simply keep going until no thread is left, remembering the last
+// position a `MATCH` instruction was reached. `MATCH` instructions hold the
+// index of their rule in `x`. rules that don't compile are left to the
+// backtracker, which has to try every length in turn. they're compiled
+// loosely instead, so their longest loose match bounds the lengths to try
+
+struct cpsre_lexer {
+  struct cpsre_pike pike;
+  char **rules;
+  int nrules;
+  int *starts, nstarts;       // where the programs of the rules begin
+  int *fallbacks, nfallbacks; // the rules compiled loosely, by index
+  size_t *ends;               // the longest match of every rule, by index
+  void *vm;                   // `vm_size(pike.len)` bytes, see `start`
+};
+
+struct cpsre_lexer *cpsre_lexer(char **rules, int nrules) {
+  struct cpsre_lexer *lexer = malloc(sizeof(*lexer));
+  if (lexer == NULL)
+    return NULL;
+  *lexer = (struct cpsre_lexer){.rules = rules, .nrules = nrules};
+
+  size_t size = 0;
+  for (int rule = 0; rule < nrules; rule++)
+    size += strlen(rules[rule]) * 3 + 1;
+  lexer->pike.prog = malloc((size + 1) * sizeof(struct inst));
+  lexer->starts = malloc((nrules + 1) * sizeof(int));
+  lexer->fallbacks = malloc((nrules + 1) * sizeof(int));
+  lexer->ends = malloc((nrules + 1) * sizeof(size_t));
+  if (lexer->pike.prog == NULL || lexer->starts == NULL ||
+      lexer->fallbacks == NULL || lexer->ends == NULL)
+    return cpsre_lexer_free(lexer), NULL;
+
+  for (int rule = 0; rule < nrules; rule++) {
+    int start = lexer->pike.len;
+    if (*cpsre_parse(rules[rule]) != '\0')
+      continue; // ill-formed rules never match
+    if (!compile_regex(&lexer->pike, rules[rule])) {
+      lexer->pike.len = start, lexer->pike.loose = true;
+      compile_regex(&lexer->pike, rules[rule]);
+      lexer->pike.loose = false, lexer->fallbacks[lexer->nfallbacks++] = rule;
+    }
+    emit(&lexer->pike, (struct inst){.op = MATCH, .x = rule});
+    lexer->starts[lexer->nstarts++] = start;
+  }
+
+  if ((lexer->vm = malloc(vm_size(lexer->pike.len))) == NULL)
+    return cpsre_lexer_free(lexer), NULL;
+  return lexer;
+}
+
+void cpsre_lexer_free(struct cpsre_lexer *lexer) {
+  free(lexer->pike.prog);
+  free(lexer->starts);
+  free(lexer->fallbacks);
+  free(lexer->ends);
+  free(lexer->vm);
+  free(lexer);
+}
+
+int cpsre_lex(struct cpsre_lexer *lexer, char *input, size_t *len) {
+  struct cpsre_pike *pike = &lexer->pike;
+  struct vm vm;
+  start(pike, &vm, input, NULL, true, lexer->vm);
+  struct list clist = vm.clist, nlist = vm.nlist;
+  for (int rule = 0; rule < lexer->nrules; rule++)
+    lexer->ends[rule] = 0;
+  for (int i = 0; i < lexer->nstarts; i++)
+    add_thread(pike, &clist, vm.seen, vm.stack, 0,
+               (struct thread){lexer->starts[i], input});
+
+  for (char *pos = input; clist.len; pos++) {
+    // later positions are longer matches
+    int step = pos - input;
+    nlist.len = 0;
+    for (int i = 0; i < clist.len; i++) {
+      struct inst *inst = &pike->prog[clist.threads[i].pc];
+      if (inst->op == MATCH)
+        lexer->ends[inst->x] = step;
+      else if (*pos &&
+               (inst->lower <= *pos && *pos <= inst->upper) ^ inst->compl)
+        add_thread(pike, &nlist, vm.seen, vm.stack, step + 1,
+                   (struct thread){clist.threads[i].pc + 1, input});
+    }
+
+    if (*pos == '\0')
+      break;
+    struct list temp = clist;
+    clist = nlist, nlist = temp;
+  }
+
+  // lower rule indices win among matches of the same length. only nonempty
+  // matches are tokens
+  int rule = -1;
+  *len = 0;
+  for (int r = 0, i = 0; r < lexer->nrules; r++)
+    if (i < lexer->nfallbacks && lexer->fallbacks[i] == r)
+      i++;
+    else if (lexer->ends[r] > *len)
+      rule = r, *len = lexer->ends[r];
+
+  for (int i = 0; i < lexer->nfallbacks; i++) {
+    // try lengths from the longest loose match down to the longest match so
+    // far, which this rule only beats if it comes first
+    int fallback = lexer->fallbacks[i];
+    char *regex = lexer->rules[fallback];
+    size_t min = *len + (fallback > rule);
+    for (size_t n = lexer->ends[fallback]; n >= min; n--)
+      if (cpsre_anchored(regex, input, input + n) != NULL) {
+        rule = fallback, *len = n;
+        break;
+      }
+  }
+
+  return rule;
+}
+
+int cpsre_lex_next(struct cpsre_lexer *lexer, char **input, size_t *len) {
+  if (**input == '\0')
+    return -1;
+  int rule = cpsre_lex(lexer, *input, len);
+  if (rule >= 0)
+    *input += *len;
+  return rule;
+}
@@ -0,0 +1,70 @@
+#include "cps-re.h"
+#include <string.h>
+
+// search and replace. matches are found like `cpsre_unanchored` finds them,
+// left to right, and the text between them is copied to the output in bulk.
+// nothing is allocated, so redacting a string costs only the matching. with a
+// precompiled pike vm, a single run of the vm finds both ends of every match,
+// so replacing takes linear time for regexes it can run
+
+static void append(char *out, size_t size, size_t *len, char *str, size_t n) {
+  // append the `n` characters at `str` to the output, as far as they fit
+  if (*len < size)
+    memcpy(out + *len, str, n < size - *len ? n : size - *len);
+  *len += n;
+}
+
+static char *find(struct cpsre_pike *pike, char *regex, char *input,
+                  char **end) {
+  // without a pike vm, the backtracker finds the match
+  if (pike != NULL)
+    return cpsre_pike_find(pike, input, end);
+  char *begin = cpsre_unanchored(regex, input, NULL);
+  *end = begin == NULL ? NULL : cpsre_anchored(regex, begin, NULL);
+  return begin;
+}
+
+static size_t replace(struct cpsre_pike *pike, char *regex, char *input,
+                      char *replacement, char *out, size_t size) {
+  size_t len = 0;
+  char *begin, *end;
+
+  while ((begin = find(pike, regex, input, &end)) != NULL) {
+    append(out, size, &len, input, begin - input);
+    for (char *rep = replacement; *rep; rep++)
+      if (*rep == '&')
+        append(out, size, &len, begin, end - begin);
+      else {
+        if (*rep == '\\' && (rep[1] == '&' || rep[1] == '\\'))
+          rep++;
+        append(out, size, &len, rep, 1);
+      }
+
+    // after an empty match, move on to the next character so we don't find the
+    // same match again
+    input = end;
+    if (end == begin) {
+      if (*input == '\0')
+        break;
+      append(out, size, &len, input++, 1);
+    }
+  }
+
+  append(out, size, &len, input, strlen(input));
+  if (size)
+    out[len < size ? len : size - 1] = '\0';
+  return len;
+}
+
+size_t cpsre_replace(char *regex, char *input, char *replacement, char *out,
+                     size_t size) {
+  // ill-formed regexes replace nothing
+  if (*cpsre_parse(regex) != '\0')
+    regex = "~.";
+  return replace(NULL, regex, input, replacement, out, size);
+}
+
+size_t cpsre_pike_replace(struct cpsre_pike *pike, char *input,
+                          char *replacement, char *out, size_t size) {
+  return replace(pike, NULL, input, replacement, out, size);
+}
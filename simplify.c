@@ -0,0 +1,237 @@
+#include "cps-re.h"
+#include "parse.h"
+#include <stdlib.h>
+
+// an algebraic simplifier. every rewrite below preserves not only what a
+// subexpression matches but also the order in which the backtracker tries its
+// matches, save for trying some of them again. as continuations are
+// deterministic, a retry can only fail like the first try did, so the results
+// of matching are unaffected, greedy, lazy and possessive quantifiers alike.
+// simplification happens bottom-up in a single pass, and never makes a regex
+// longer, so it can be written to a buffer the size of the original regex.
+// possessification then happens in a second pass, which adds at most one
+// character per factor
+
+static char *simplify_regex(char *regex, char *out);
+
+static bool has_binop(char *regex, char binop) {
+  // whether `regex` has `binop` outside of parentheses
+  while (regex = parse_term(regex), *regex == '|' || *regex == '&')
+    if (*regex++ == binop)
+      return true;
+  return false;
+}
+
+static bool merge_quants(char *first, char *second, bool nested, char *out) {
+  // try to write a quantifier `out` such that `X{first}X{second}`, or
+  // `(X{first}){second}` if `nested`, is `X{out}` for a character class `X`.
+  // quantifiers are null-terminated. only stars and pluses with the same
+  // modifier merge, and `out` then has that modifier too
+  char mod = first[1];
+  if (!*first || !strchr("*+", *first) || !*second ||
+      !strchr("*+", *second) || second[1] != mod)
+    return false;
+
+  if (mod == '+') {
+    // `a*+a*+` is `a*+` and `a++a*+` is `a++`, as the second can't match
+    if (nested || *second != '*')
+      return false;
+    return out[0] = *first, out[1] = mod, true;
+  }
+
+  // `a*a+` is `a+` and `(a+)*` is `a*`, but `a+a+` is not `a+`
+  if (*first == '+' && *second == '+' && !nested)
+    return false;
+  bool plus = nested ? *first == '+' && *second == '+'
+                     : *first == '+' || *second == '+';
+  return out[0] = plus ? '+' : '*', out[1] = mod, true;
+}
+
+static char *simplify_factor(char *factor, char *out) {
+  // write a simplified `factor` to `out`, as zero or more factors
+  char *quant = parse_atom(factor), *end = parse_factor(factor);
+  char quants[3] = {0}, merged[2];
+  memcpy(quants, quant, end - quant);
+
+  if (*factor != '(') {
+    // `.*?` is `%`
+    if (*factor == '.' && strcmp(quants, "*?") == 0)
+      return *out++ = '%', out;
+    return memcpy(out, factor, end - factor), out + (end - factor);
+  }
+
+  char *inner = out + 1, *inner_end = simplify_regex(factor + 1, inner);
+  size_t inner_len = inner_end - inner;
+  bool term = *inner != '!' && *parse_term(inner) == '\0';
+  char *inner_quant = term && *inner ? parse_atom(inner) : NULL;
+  bool single = inner_quant != NULL && *parse_factor(inner) == '\0';
+
+  if (*quants == '\0' && term) {
+    // `(ab)` is `ab`
+    memmove(out, inner, inner_len);
+    return out + inner_len;
+  }
+  if (single && *inner_quant == '\0') {
+    // `(a)*` is `a*`
+    memmove(out, inner, inner_len);
+    memcpy(out + inner_len, quants, strlen(quants));
+    return out + inner_len + strlen(quants);
+  }
+  if (single && is_class(inner) &&
+      merge_quants(inner_quant, quants, true, merged)) {
+    // `(a*)*` is `a*`
+    size_t atom_len = inner_quant - inner, quant_len = merged[1] ? 2 : 1;
+    memmove(out, inner, atom_len);
+    memcpy(out + atom_len, merged, quant_len);
+    return out + atom_len + quant_len;
+  }
+
+  *out = '(', *inner_end = ')';
+  memcpy(inner_end + 1, quants, strlen(quants));
+  return inner_end + 1 + strlen(quants);
+}
+
+static char *merge_factors(char *factors) {
+  // merge adjacent factors of the null-terminated `factors` in place, and
+  // return the new end
+  char *read = factors, *write = factors;
+  size_t prev_len = 0, prev_atom_len = 0; // of the factor written last
+  char prev_quants[3] = {0};
+
+  while (*read) {
+    char *next = parse_factor(read), *quant = parse_atom(read), merged[2];
+    char *prev = write - prev_len, quants[3] = {0};
+    size_t len = next - read, atom_len = quant - read;
+    memcpy(quants, quant, next - quant);
+
+    // `%%` is `%`
+    if (prev_len == 1 && *prev == '%' && len == 1 && *read == '%') {
+      read = next;
+      continue;
+    }
+    // `a*a*` is `a*`. modifiers match, so `merged` is as long as `prev_quants`
+    if (prev_len && is_class(read) && prev_atom_len == atom_len &&
+        memcmp(prev, read, atom_len) == 0 &&
+        merge_quants(prev_quants, quants, false, merged)) {
+      memcpy(prev + atom_len, merged, prev_len - atom_len);
+      memcpy(prev_quants, merged, prev_len - atom_len);
+      read = next;
+      continue;
+    }
+
+    memmove(write, read, len);
+    prev_len = len, prev_atom_len = atom_len;
+    memcpy(prev_quants, quants, sizeof(quants));
+    write += len, read = next;
+  }
+
+  *write = '\0';
+  return write;
+}
+
+static char *simplify_term(char *term, char *out) {
+  if (*term == '!')
+    *out++ = *term++;
+  char *factors = out;
+  *out = '\0';
+  for (char *next; (next = parse_factor(term)) != NULL; term = next)
+    out = simplify_factor(term, out), *out = '\0';
+  return merge_factors(factors);
+}
+
+static char *dedupe(char *regex) {
+  // `a|b|a` is `a|b`, as the second `a` can only retry what the first tried.
+  // `regex` must have no `&` outside of parentheses
+  char *read = regex, *write = regex;
+  while (1) {
+    char *end = parse_term(read), sep = *end;
+    size_t len = end - read;
+    bool dup = false;
+    for (char *prev = regex; prev < write && !dup; prev = parse_term(prev) + 1)
+      dup = (size_t)(parse_term(prev) - prev) == len &&
+            memcmp(prev, read, len) == 0;
+    if (!dup)
+      memmove(write, read, len), write += len, *write++ = '|';
+    if (sep != '|')
+      break;
+    read = end + 1;
+  }
+  *--write = '\0';
+  return write;
+}
+
+static char *simplify_regex(char *regex, char *out) {
+  // write a simplified `regex` to `out`, null-terminated, and return its end
+  char *begin = out;
+  while (1) {
+    char *binop = parse_term(regex), *term = out;
+    out = simplify_term(regex, out);
+
+    // `(a|b)|c` is `a|b|c` and `a&(b&c)` is `a&b&c`, but `(a|b)&c` is not
+    // `a|b&c`, as alternation and intersection are right-associative
+    if (*term == '(' && parse_factor(term) == out && parse_atom(term) == out) {
+      out[-1] = '\0';
+      bool last = *binop != '|' && *binop != '&';
+      if (last || (*binop == '|' && !has_binop(term + 1, '&'))) {
+        memmove(term, term + 1, out - term - 2);
+        out -= 2;
+      } else
+        out[-1] = ')';
+    }
+
+    if (*binop != '|' && *binop != '&')
+      break;
+    *out++ = *binop, regex = binop + 1;
+  }
+
+  *out = '\0';
+  return has_binop(begin, '&') ? out : dedupe(begin);
+}
+
+static char *possessify_regex(char *regex, char *out);
+static char *possessify_term(char *term, char *out) {
+  // make greedy quantifiers possessive where backtracking into them can't help.
+  // for example in `a*b`, giving back an `a` leaves an `a` where `b` must
+  // match, so `a*b` is `a*+b`
+  if (*term == '!')
+    *out++ = *term++;
+  for (char *next; (next = parse_factor(term)) != NULL; term = next) {
+    char *quant = parse_atom(term);
+    if (*term == '(') {
+      *out++ = '(', out = possessify_regex(term + 1, out);
+      memcpy(out, quant - 1, next - quant + 1), out += next - quant + 1;
+    } else
+      memcpy(out, term, next - term), out += next - term;
+    if (next - quant == 1 && is_class(term) && excludes(next, term))
+      *out++ = '+';
+  }
+  return out;
+}
+
+static char *possessify_regex(char *regex, char *out) {
+  while (1) {
+    char *binop = parse_term(regex);
+    out = possessify_term(regex, out);
+    if (*binop != '|' && *binop != '&')
+      return out;
+    *out++ = *binop, regex = binop + 1;
+  }
+}
+
+size_t cpsre_simplify(char *regex, char *out, size_t size) {
+  size_t len = strlen(regex);
+  char *buf = malloc(len + 1), *poss = malloc(len * 2 + 1);
+
+  // leave ill-formed regexes alone, and also regexes if we're out of memory
+  if (buf != NULL && poss != NULL && *cpsre_parse(regex) == '\0') {
+    simplify_regex(regex, buf);
+    len = possessify_regex(buf, poss) - poss, regex = poss;
+  }
+  if (size > 0) {
+    size_t copy = len < size - 1 ? len : size - 1;
+    memcpy(out, regex, copy), out[copy] = '\0';
+  }
+
+  free(buf), free(poss);
+  return len;
+}
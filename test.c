@@ -1,10 +1,36 @@
 #include "cps-re.h"
 #include <ctype.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef GEN_MATCHERS
+// run the test suite against the matchers `cpsre-gen` emitted for it instead
+extern struct cpsre_gen gen_matchers[];
+
+struct cpsre_gen *gen_lookup(char *regex) {
+  for (struct cpsre_gen *gen = gen_matchers; gen->regex; gen++)
+    if (strcmp(gen->regex, regex) == 0)
+      return gen;
+  abort();
+}
+
+char *gen_anchored(char *regex, char *input, char *target) {
+  return gen_lookup(regex)->anchored(input, target);
+}
+
+char *gen_unanchored(char *regex, char *input, char *target) {
+  return gen_lookup(regex)->unanchored(input, target);
+}
+
+#define cpsre_anchored gen_anchored
+#define cpsre_unanchored gen_unanchored
+#endif
+
+bool list_regexes; // print the regexes under test instead of testing them
+
 void dump(char *begin, char *end, char delim) {
   if (begin == NULL)
     printf("no match");
@@ -26,6 +52,10 @@ void test(char *regex, char *input, char *partial, bool exact) {
     printf("test failed: "), dump(regex, NULL, '/'), printf(" parse\n");
   if (parse_error || input == NULL)
     return;
+  if (list_regexes) {
+    fwrite(regex, strlen(regex) + 1, 1, stdout);
+    return;
+  }
 
   char *partial_begin = cpsre_unanchored(regex, input, NULL);
   char *partial_end = cpsre_anchored(
@@ -34,6 +64,104 @@ void test(char *regex, char *input, char *partial, bool exact) {
 
   if (exact_end != NULL && exact_end != strchr(input, '\0'))
     abort();
+  if (cpsre_unanchored_parallel(regex, input, NULL, 4) != partial_begin)
+    abort();
+  if (cpsre_unanchored_until(regex, input, strchr(input, '\0') + 1, NULL) !=
+          partial_begin ||
+      (partial_begin != NULL &&
+       cpsre_unanchored_until(regex, input, partial_begin, NULL) != NULL))
+    abort();
+
+  struct cpsre_jit *jit = cpsre_jit(regex);
+  if (jit == NULL)
+    abort();
+  if (cpsre_jit_unanchored(jit, input, NULL) != partial_begin ||
+      cpsre_jit_anchored(jit, input, strchr(input, '\0')) != exact_end)
+    abort();
+  if (partial_begin != NULL &&
+      cpsre_jit_anchored(jit, partial_begin, NULL) != partial_end)
+    abort();
+  cpsre_jit_free(jit);
+
+  struct cpsre_pike *pike = cpsre_pike(regex);
+  if (pike == NULL)
+    abort();
+  if (cpsre_pike_unanchored(pike, input, NULL) != partial_begin ||
+      cpsre_pike_anchored(pike, input, strchr(input, '\0')) != exact_end)
+    abort();
+  if (partial_begin != NULL &&
+      cpsre_pike_anchored(pike, partial_begin, NULL) != partial_end)
+    abort();
+  char *find_end;
+  if (cpsre_pike_find(pike, input, &find_end) != partial_begin ||
+      (partial_begin != NULL && find_end != partial_end))
+    abort();
+
+  if (cpsre_pike_unanchored(pike, input, strchr(input, '\0')) !=
+          cpsre_unanchored(regex, input, strchr(input, '\0')) ||
+      cpsre_pike_anchored(pike, input, NULL) !=
+          cpsre_anchored(regex, input, NULL))
+    abort();
+
+  // resumable searches find the same match one step per character, and are
+  // only supported on the vm
+  struct cpsre_search *search = cpsre_search(pike, input, NULL);
+  if ((search == NULL) != !cpsre_pike_linear(pike))
+    abort();
+  char *begin, *end;
+  int result;
+  size_t steps = 0;
+  while (search != NULL &&
+         (result = cpsre_search_run(search, 1, &begin, &end)) == CPSRE_PENDING)
+    steps++;
+  if (search != NULL &&
+      (result != (partial_begin != NULL) ||
+       cpsre_search_run(search, 0, &begin, &end) != result ||
+       (result && (begin != partial_begin || end != partial_end)) ||
+       steps > strlen(input) + 1))
+    abort();
+  if (search != NULL)
+    cpsre_search_free(search);
+
+  // saved regexes behave the same, and corrupted ones fail to load
+  size_t size = cpsre_pike_save(pike, NULL, 0);
+  char *buf = malloc(size);
+  if (buf == NULL || cpsre_pike_save(pike, buf, size) != size)
+    abort();
+  cpsre_pike_free(pike);
+  if ((pike = cpsre_pike_load(buf, size)) == NULL)
+    abort();
+  if (cpsre_pike_unanchored(pike, input, NULL) != partial_begin ||
+      cpsre_pike_anchored(pike, input, strchr(input, '\0')) != exact_end)
+    abort();
+  buf[size - 1] ^= 1;
+  if (cpsre_pike_load(buf, size) != NULL || cpsre_pike_load(buf, size - 1))
+    abort();
+  cpsre_pike_free(pike), free(buf);
+
+  // every regex can be classified
+  char *culprit;
+  int degree = cpsre_complexity(regex, &culprit);
+  if (degree == 0 || degree < CPSRE_EXPONENTIAL ||
+      (culprit != NULL && (culprit < regex || culprit >= strchr(regex, '\0'))))
+    abort();
+
+  // simplified regexes behave the same
+  char simplified[cpsre_simplify(regex, NULL, 0) + 1];
+  if (cpsre_simplify(regex, simplified, sizeof(simplified)) + 1 !=
+          sizeof(simplified) ||
+      (pike = cpsre_pike(simplified)) == NULL)
+    abort();
+  if (cpsre_pike_unanchored(pike, input, NULL) != partial_begin ||
+      cpsre_pike_anchored(pike, input, strchr(input, '\0')) != exact_end)
+    abort();
+  if (partial_begin != NULL &&
+      cpsre_pike_anchored(pike, partial_begin, NULL) != partial_end)
+    abort();
+  cpsre_pike_free(pike);
+  if (cpsre_unanchored_parallel(regex, input, strchr(input, '\0'), 4) !=
+      cpsre_unanchored(regex, input, strchr(input, '\0')))
+    abort();
   if (!!exact_end != exact) {
     printf("test failed: "), dump(regex, NULL, '/'), printf(" ");
     printf("against "), dump(input, NULL, '\''), printf(": ");
@@ -59,7 +187,215 @@ void test(char *regex, char *input, char *partial, bool exact) {
   }
 }
 
-int main(void) {
+void test_simplify(char *regex, char *simplified) {
+  // ensure `regex` simplifies to `simplified`
+  char out[256];
+  if (list_regexes)
+    return;
+  if (cpsre_simplify(regex, out, sizeof(out)) != strlen(out) ||
+      strcmp(out, simplified) != 0) {
+    printf("test failed: "), dump(regex, NULL, '/'), printf(" simplifies to ");
+    dump(out, NULL, '/'), printf(", expected "), dump(simplified, NULL, '/');
+    printf("\n");
+  }
+}
+
+void test_complexity(char *regex, int degree, int culprit) {
+  // ensure `regex` is classified as `degree`, blaming the subexpression at
+  // offset `culprit`, or nothing if `culprit` is negative
+  char *got;
+  if (list_regexes)
+    return;
+  int got_degree = cpsre_complexity(regex, &got);
+  if (got_degree != degree || (got ? got - regex : -1) != culprit) {
+    printf("test failed: "), dump(regex, NULL, '/');
+    printf(": expected degree %d at %d, got %d at %d\n", degree, culprit,
+           got_degree, got ? (int)(got - regex) : -1);
+  }
+}
+
+void test_lines(char *regex, char *buf, char *matches) {
+  // ensure the lines of `buf` match as described by the `0`s and `1`s of
+  // `matches`, and that `buf` is left unchanged
+  char copy[strlen(buf) + 1];
+  unsigned char bitmap[strlen(buf) / 8 + 1];
+  if (list_regexes)
+    return;
+  strcpy(copy, buf);
+  size_t nlines = cpsre_match_lines(regex, copy, strlen(copy), bitmap);
+  if (strcmp(copy, buf) != 0)
+    abort();
+  for (size_t i = 0; i < nlines || matches[i]; i++)
+    if (i >= nlines || !matches[i] ||
+        (bitmap[i / 8] >> i % 8 & 1) != (matches[i] == '1')) {
+      printf("test failed: "), dump(regex, NULL, '/'), printf(" against ");
+      dump(buf, NULL, '\''), printf(": expected %s\n", matches);
+      return;
+    }
+}
+
+void test_replace(char *regex, char *input, char *replacement, char *result) {
+  // ensure replacing matches of `regex` in `input` gives `result`, also when
+  // the output buffer is too small, and also with a precompiled pike vm
+  char out[256], small[4], pike_out[256];
+  if (list_regexes)
+    return;
+  struct cpsre_pike *pike = cpsre_pike(regex);
+  if (pike == NULL)
+    abort();
+  size_t len = cpsre_replace(regex, input, replacement, out, sizeof(out));
+  size_t pike_len =
+      cpsre_pike_replace(pike, input, replacement, pike_out, sizeof(pike_out));
+  cpsre_pike_free(pike);
+  if (len != strlen(result) || strcmp(out, result) != 0 || pike_len != len ||
+      strcmp(pike_out, result) != 0 ||
+      cpsre_replace(regex, input, replacement, NULL, 0) != len ||
+      cpsre_replace(regex, input, replacement, small, sizeof(small)) != len ||
+      strncmp(small, result, sizeof(small) - 1) != 0 ||
+      strlen(small) != (len < sizeof(small) ? len : sizeof(small) - 1)) {
+    printf("test failed: "), dump(regex, NULL, '/'), printf(" against ");
+    dump(input, NULL, '\''), printf(": expected "), dump(result, NULL, '\'');
+    printf(", got "), dump(out, NULL, '\''), printf("\n");
+  }
+}
+
+void test_lex(char **rules, int nrules, char *input, char *tokens) {
+  // ensure lexing `input` with `rules` gives `tokens`, which lists every token
+  // as its rule index and its text, such as `0:abc,1:+`
+  char got[256] = "", *pos = input;
+  size_t len;
+  int rule;
+  if (list_regexes)
+    return;
+  struct cpsre_lexer *lexer = cpsre_lexer(rules, nrules);
+  if (lexer == NULL)
+    abort();
+  while ((rule = cpsre_lex_next(lexer, &pos, &len)) >= 0)
+    sprintf(got + strlen(got), "%s%d:%.*s", *got ? "," : "", rule, (int)len,
+            pos - len);
+  if (*pos)
+    sprintf(got + strlen(got), "%s!%s", *got ? "," : "", pos);
+  cpsre_lexer_free(lexer);
+
+  if (strcmp(got, tokens) != 0) {
+    printf("test failed: lexing "), dump(input, NULL, '\'');
+    printf(": expected %s, got %s\n", tokens, got);
+  }
+}
+
+void test_lex_long(char *rule, int ntokens) {
+  // ensure lexing `ntokens` tokens such as `12` separated by spaces, with a
+  // `rule` for the tokens that the vm can't run, gives every token in turn
+  // without trying every length of the rest of the input
+  char *rules[] = {rule, " "}, *input = malloc(ntokens * 3 + 1), *pos = input;
+  size_t len;
+  int rule_index, n = 0;
+  if (list_regexes || input == NULL) {
+    free(input);
+    return;
+  }
+  for (int i = 0; i < ntokens; i++)
+    strcpy(input + i * 3, "12 ");
+
+  struct cpsre_lexer *lexer = cpsre_lexer(rules, 2);
+  if (lexer == NULL)
+    abort();
+  while ((rule_index = cpsre_lex_next(lexer, &pos, &len)) == n % 2 &&
+         len == (size_t)(2 - n % 2))
+    n++;
+  cpsre_lexer_free(lexer), free(input);
+
+  if (rule_index >= 0 || n != ntokens * 2)
+    printf("test failed: lexing %d tokens with /%s/: got %d\n", ntokens, rule,
+           n);
+}
+
+void test_load(int32_t len, int32_t regex_size) {
+  // ensure a saved regex fails to load if its header claims `len` instructions
+  // and a regex of `regex_size` bytes, which follow the magic number and four
+  // other 32-bit fields in the header
+  if (list_regexes)
+    return;
+  struct cpsre_pike *pike = cpsre_pike("a|b");
+  size_t size = pike == NULL ? 0 : cpsre_pike_save(pike, NULL, 0);
+  char *buf = malloc(size);
+  if (buf == NULL || cpsre_pike_save(pike, buf, size) != size)
+    abort();
+  memcpy(buf + 24, &len, sizeof(len));
+  memcpy(buf + 28, &regex_size, sizeof(regex_size));
+  struct cpsre_pike *loaded = cpsre_pike_load(buf, size);
+  if (loaded != NULL)
+    printf("test failed: loading %ld instructions and %ld bytes of regex\n",
+           (long)len, (long)regex_size),
+        cpsre_pike_free(loaded);
+  cpsre_pike_free(pike), free(buf);
+}
+
+void test_search(char *regex, char *input, size_t steps, bool pending) {
+  // ensure a resumable search is still pending after `steps` steps if and only
+  // if `pending`, and that it then finds the first partial match. regexes only
+  // the backtracker can run must be refused, and not be `pending`
+  char *begin = NULL, *end = NULL;
+  if (list_regexes)
+    return;
+  struct cpsre_pike *pike = cpsre_pike(regex);
+  struct cpsre_search *search;
+  if (pike == NULL)
+    abort();
+  if ((search = cpsre_search(pike, input, NULL)) == NULL) {
+    if (pending || cpsre_pike_linear(pike))
+      printf("test failed: searching for "), dump(regex, NULL, '/'),
+          printf(": unsupported\n");
+    cpsre_pike_free(pike);
+    return;
+  }
+  int result = cpsre_search_run(search, steps, &begin, &end);
+  while (cpsre_search_run(search, 1, &begin, &end) == CPSRE_PENDING)
+    ;
+  bool found = begin == cpsre_pike_unanchored(pike, input, NULL);
+  cpsre_search_free(search), cpsre_pike_free(pike);
+
+  if ((result == CPSRE_PENDING) != pending || !found) {
+    printf("test failed: searching "), dump(input, NULL, '\'');
+    printf(" for "), dump(regex, NULL, '/');
+    printf(" in %zu steps\n", steps);
+  }
+}
+
+void test_long(int nwords, bool empty, char *input, char *partial) {
+  // ensure an alternation of `nwords` words such as `w00042`, or if `empty` of
+  // `a` and then empty words, whose program is too large for the stack, first
+  // matches `input` at `partial`, if not null, and is classified as linear
+  char *regex = malloc(nwords * 7 + 1), *pos = regex, *begin, *end;
+  if (list_regexes || regex == NULL) {
+    free(regex);
+    return;
+  }
+  for (int i = 0; i < nwords; i++)
+    pos += empty ? sprintf(pos, "%s", i ? "|" : "a")
+                 : sprintf(pos, "%sw%05d", i ? "|" : "", i);
+
+  struct cpsre_pike *pike = cpsre_pike(regex);
+  if (pike == NULL || !cpsre_pike_linear(pike))
+    abort();
+  char *culprit;
+  if (cpsre_complexity(regex, &culprit) != 1)
+    printf("test failed: %d words: expected linear\n", nwords);
+  begin = cpsre_pike_unanchored(pike, input, NULL);
+  end = begin == NULL ? NULL : cpsre_pike_anchored(pike, begin, NULL);
+  if (partial == NULL ? begin != NULL
+                      : begin != strstr(input, partial) ||
+                            end != begin + strlen(partial))
+    printf("test failed: %d words against ", nwords), dump(input, NULL, '\''),
+        printf("\n");
+  cpsre_pike_free(pike), free(regex);
+}
+
+int main(int argc, char **argv) {
+  // `bin/test --regexes` lists the well-formed regexes of the test suite as
+  // null-terminated strings, for `cpsre-gen -t`
+  list_regexes = argc == 2 && strcmp(argv[1], "--regexes") == 0;
+
   // potential edge cases (mostly from LTRE)
   test("abba", "abba", "abba", true);
   test("ab|abba", "abba", "ab", true);
@@ -126,6 +462,12 @@ int main(void) {
   test("x?|y?", "xy", "x", false);
   test("x+|y*", "xy", "x", false);
   test("x*|y+", "xy", "x", false);
+  test("a*b|a*c", "aac", "aac", true);
+  test("x?yz|xy|x", "xy", "xy", true);
+  test("(x|)y|xz", "xz", "xz", true);
+  test("abc|abd|b", "abd", "abd", true);
+  test("~a|a|b", "b", "b", true);
+  test("%c|b", "bc", "bc", true);
 
   // greedy, lazy, possessive
   test("a*", "aa", "aa", true);
@@ -298,6 +640,151 @@ int main(void) {
   test("!!a", NULL, NULL, false);
   test("a!!b", NULL, NULL, false);
 
+  // bit-parallel engine: states spanning several bytes, up to 64 states
+  test("(abc|abd|a-z0-9x)+y", "zabdabcc5xyz", "abdabcc5xy", false);
+  test("(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)", "abbbbbbbbb", "abbbbbbb",
+       false);
+  test("%(ab)+c%", "xababcx", "xababc", true);
+  test("a*?b??c+?", "abbc", "bc", false);
+  test("\\(a-c*+\\)", "(ab)c)", "(ab)", false);
+  test("%x(ab|a)(c|bcd)(d*)", "xabcd", "xabcd", true);
+  test("(a*)*abcd|c", "xabcd", "abcd", false);
+  test("(a|b*)*d|c", "ababcd", "c", false);
+  test("(a|b*)*d|c", "ababd", "ababd", true);
+  // 64 states, then 65, which is too many
+#define L32 "abcdefghabcdefghabcdefghabcdefgh"
+  test(L32 L32, L32 L32 "x", L32 L32, false);
+  test(L32 L32 "x", L32 L32 "x", L32 L32 "x", true);
+#undef L32
+
+  // simplification
+  test_simplify("((a))", "a");
+  test_simplify("a(bc)d", "abcd");
+  test_simplify("(x|x)", "x");
+  test_simplify("x|y|x", "x|y");
+  test_simplify("x|y&x|x", "x|y&x|x");
+  test_simplify("(a|b)|c", "a|b|c");
+  test_simplify("(a|b)&c", "(a|b)&c");
+  test_simplify("c&(a|b)", "c&a|b");
+  test_simplify("!(ab)c", "!abc");
+  test_simplify("(a)*", "a*");
+  test_simplify("((a|b))*", "(a|b)*");
+  test_simplify("(a*)*", "a*");
+  test_simplify("(a+?)*?", "a*?");
+  test_simplify("(a*)*?", "(a*)*?");
+  test_simplify("(a*+)*", "(a*+)*");
+  test_simplify("a*a*", "a*");
+  test_simplify("a*a+", "a+");
+  test_simplify("a+a+", "a+a+");
+  test_simplify("a*a*?", "a*a*?");
+  test_simplify("a*+a*+", "a*+");
+  test_simplify("a*+a++", "a*+a++");
+  test_simplify("%%", "%");
+  test_simplify(".*?.*?", "%");
+  test_simplify("()", "");
+  test_simplify("(a", "(a");
+  test_simplify("a*b", "a*+b");
+  test_simplify("0-9+,", "0-9++,");
+  test_simplify("a?b?c", "a?+b?+c");
+  test_simplify("~a*a", "~a*+a");
+  test_simplify("(a*b)*", "(a*+b)*");
+  test_simplify("a*", "a*");
+  test_simplify("a*a", "a*a");
+  test_simplify("a*b?", "a*b?");
+  test_simplify("a*%b", "a*%b");
+  test_simplify("a*(b)", "a*+b");
+  test_simplify("a*(b|c)", "a*(b|c)");
+  test_simplify("a*?b", "a*?b");
+  test_simplify(".*b", ".*b");
+
+  // complexity classification
+  test_complexity("", 1, -1);
+  test_complexity("abc", 1, -1);
+  test_complexity("(", 0, -1);
+  test_complexity("a*b*c*", 1, -1);
+  test_complexity("(a|b)*c", 1, -1);
+  test_complexity("x(a|ab)*", 1, -1);
+  test_complexity("(a?)*", 1, -1);
+  test_complexity("a*ba*", 1, -1);
+  test_complexity("a*a*", 2, 0);
+  test_complexity("x0-9+\\.?0-9+", 2, 1);
+  test_complexity("%a%b%c", 3, 0);
+  test_complexity("(a*)*", CPSRE_EXPONENTIAL, 0);
+  test_complexity("x(a|a)*", CPSRE_EXPONENTIAL, 1);
+  test_complexity("(a+)+b", CPSRE_EXPONENTIAL, 0);
+  test_complexity("x*(a|aa)*y", CPSRE_EXPONENTIAL, 2);
+  test_complexity("(%)*", CPSRE_EXPONENTIAL, 0);
+  test_complexity("!a", 1, -1);
+  test_complexity("a(!b*)c", 2, 2);
+  test_complexity("(!a)*", CPSRE_EXPONENTIAL, 0);
+  test_complexity("a*&b*", 2, 0);
+  test_complexity("a&b&(c|c)*", CPSRE_EXPONENTIAL, 4);
+  // regexes too costly to analyze are rejected, with no one to blame
+  char loops[4001] = "";
+  for (int i = 0; i < 2000; i++)
+    strcat(loops, "a*");
+  test_complexity(loops, CPSRE_EXPONENTIAL, -1);
+
+  // line matching
+  test_lines("b", "", "");
+  test_lines("b", "\n", "0");
+  test_lines("b", "abc\nxyz\nb", "101");
+  test_lines("b", "abc\nxyz\nb\n", "101");
+  test_lines("", "a\n\nb", "111");
+  test_lines("x|y", "a\nx\nay\nz\n", "0110");
+  test_lines("a-c+&!b", "b\nab\ncc\n\n", "0110");
+  test_lines("%x", "ab\nabx", "01");
+  test_lines("0-9+,", "1\n22,\n,3\n4,\n5\n6\n7\n8\n9,", "010100001");
+
+  // search and replace
+  test_replace("b", "abcb", "x", "axcx");
+  test_replace("b+", "abbcb", "<&>", "a<bb>c<b>");
+  test_replace("b", "abc", "\\&\\\\", "a&\\c");
+  test_replace("x*", "ab", "-", "-a-b-");
+  test_replace("a*", "baac", "-", "-b--c-");
+  test_replace("0-9+", "pin 1234, key 99", "***", "pin ***, key ***");
+  test_replace("z", "abc", "x", "abc");
+  test_replace("", "", "x", "x");
+  test_replace("(a", "abc", "x", "abc");
+
+  // lexing
+  char *rules[] = {"if|else", "a-z+", "0-9+",
+                   " +",      "=|==", "/\\*(!(%\\*/%))\\*/"};
+  int nrules = sizeof(rules) / sizeof(*rules);
+  test_lex(rules, nrules, "", "");
+  test_lex(rules, nrules, "if", "0:if");
+  test_lex(rules, nrules, "iff", "1:iff");
+  test_lex(rules, nrules, "else x == 12", "0:else,3: ,1:x,3: ,4:==,3: ,2:12");
+  test_lex(rules, nrules, "x=y", "1:x,4:=,1:y");
+  test_lex(rules, nrules, "x /* a */ y", "1:x,3: ,5:/* a */,3: ,1:y");
+  test_lex(rules, nrules, "/**/*/", "5:/**/,!*/");
+  test_lex(rules, nrules, "x;", "1:x,!;");
+  test_lex(rules, 2, "ifelse", "1:ifelse");
+  test_lex(rules + 1, 1, "if", "0:if");
+  test_lex_long("0-9+&0-9+", 5000);
+
+  // resumable search
+  test_search("b", "aaaab", 0, true);
+  test_search("b", "aaaab", 2, true);
+  test_search("b", "aaaab", 6, false);
+  test_search("a*&a", "xxa", 0, false);
+  test_search("(a", "abc", 100, false);
+  test_search("(a|ab)*c", "ababab", 3, true);
+  test_search("(a|ab)*c", "ababab", 7, false);
+
+  // saved regexes with out-of-range sizes in their header
+  test_load(INT32_MAX, INT32_MAX);
+  test_load(0, INT32_MAX);
+  test_load(INT32_MAX, 4);
+  test_load(INT32_MAX / 3, INT32_MAX / 3);
+  test_load(-1, 4);
+  test_load(5, INT32_MIN);
+
+  // long regexes
+  test_long(50000, false, "xx w49999 yy", "w49999");
+  test_long(50000, false, "xx w50000 yy", NULL);
+  test_long(100001, true, "xx a", "");
+
   // realistic regexes (mostly from LTRE)
 #define HEX_RGB "#(...(...)?&(0-9|a-f|A-F)*?)"
   test(HEX_RGB, "000", NULL, false);
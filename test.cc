@@ -0,0 +1,103 @@
+#include "cps-re.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+// the c++ interface. static regexes must return exactly what the backtracker
+// returns, from every position of every input and for every target, and so
+// must runtime regexes for the `std::string_view` helpers
+
+template <const auto &P> void test(std::initializer_list<const char *> inputs) {
+  using static_regex = cpsre::static_regex<P>;
+  cpsre::regex regex(P);
+  char pattern[sizeof(P)];
+  memcpy(pattern, P, sizeof(P));
+
+  for (const char *input : inputs) {
+    char *end = strchr(const_cast<char *>(input), '\0');
+    for (char *begin = const_cast<char *>(input); begin <= end; begin++)
+      for (char *target = begin - 1; target <= end; target++) {
+        char *t = target < begin ? nullptr : target;
+        if (static_regex::anchored(begin, t) !=
+                cpsre_anchored(pattern, begin, t) ||
+            static_regex::unanchored(begin, t) !=
+                cpsre_unanchored(pattern, begin, t)) {
+          printf("test failed: /%s/ against '%s' from %d to %d\n", pattern,
+                 input, int(begin - input), t ? int(t - input) : -1);
+          abort();
+        }
+      }
+
+    if (static_regex::match(input) != regex.match(input) ||
+        static_regex::search(input) != regex.search(input))
+      abort();
+  }
+}
+
+#define TEST(REGEX, ...)                                                       \
+  do {                                                                         \
+    static constexpr char regex[] = REGEX;                                     \
+    test<regex>({__VA_ARGS__});                                                \
+  } while (0)
+
+int main() {
+  // classes, wildcards and wraparound
+  TEST("", "", "a");
+  TEST("abc", "abc", "xabcx", "ab");
+  TEST("a-c+", "xbcay", "d");
+  TEST("~a-c*", "xyzab", "abc");
+  TEST("z-a", "az", "m", "{");
+  TEST("..", "a\n", "a");
+  TEST("~.", "", "a");
+  TEST("\\(\\*\\\\", "(*\\", "(*");
+  TEST("a%b", "aab", "axbyb", "ba");
+
+  // greedy, lazy, possessive
+  TEST("a*a", "aaa", "b");
+  TEST("a*?a", "aaa", "b");
+  TEST("a*+a", "aaa", "b");
+  TEST("a++b", "aab", "b");
+  TEST("(a|ab)++b", "abab", "aab", "abb");
+  TEST("(a|ab)+?b", "abab", "aab", "abb");
+  TEST("(a*+b)*", "abaab", "aa");
+  TEST("(a?+)*b", "aab", "b");
+  TEST("a?+a", "a", "aa");
+  TEST("(ab|a)??b", "ab", "abb");
+  TEST("a??b?", "ab", "b");
+  TEST("(a*)*b", "aaab", "aaa");
+  TEST("()*", "", "a");
+  TEST("(|a)+b", "aab", "b");
+
+  // alternation, intersection and complement
+  TEST("a|ab|abc", "abc", "x");
+  TEST("a&a*", "a", "aa");
+  TEST("%a&%b", "ab", "ba");
+  TEST("a*&b|a", "a", "b");
+  TEST("(a|b)*&!(%aa%)", "abab", "abaab");
+  TEST("!(a*)b", "bab", "aab");
+  TEST("!a", "", "a", "aa");
+  TEST("!%", "", "a");
+  TEST("x(!a*b)y", "xaby", "xay", "xy");
+
+  // realistic regexes
+  TEST("0-9+(.0-9*)?(e(\\+|\\-)?0-9+)?", "1.5e+3", "x12e", ".");
+  TEST("(a-z|0-9|_)+@(a-z+.)+a-z+", "me@example.com", "@a.b", "x@y");
+
+  // the same, through string literals
+#if __cplusplus >= 202002L
+  if (!cpsre::literal<"a+b">::match("aab") ||
+      cpsre::literal<"a+b">::search("xaabx") != "aab")
+    abort();
+#endif
+
+  // runtime regexes reject ill-formed regexes, and stop at null characters
+  try {
+    cpsre::regex("(a");
+    abort();
+  } catch (std::invalid_argument &) {
+  }
+  if (cpsre::regex("a%").match(std::string_view("ab\0c", 4)) ||
+      cpsre::regex("c").search(std::string_view("ab\0c", 4)))
+    abort();
+}